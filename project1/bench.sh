@@ -0,0 +1,176 @@
+#!/bin/bash
+set -e
+
+# Throughput benchmark for cachesim. Runs fixed configurations over the
+# bundled traces (when present) and a few synthetic ones, writes the results
+# to bench_results.json and compares accesses/second against
+# bench_baseline.json. Any run slower than the baseline by more than
+# BENCH_THRESHOLD (a fraction, default 0.10) fails the benchmark.
+#
+# The baseline is machine specific, so it is not checked in: the first run
+# records it, and `bash bench.sh --update-baseline' replaces it.
+
+results_path=bench_results.json
+baseline_path=bench_baseline.json
+synthetic_dir=bench_traces
+threshold=${BENCH_THRESHOLD:-0.10}
+reps=${BENCH_REPS:-3}
+synthetic_accesses=${BENCH_SYNTHETIC_ACCESSES:-1000000}
+
+bundled_benchmarks=( gcc leela linpack matmul_naive matmul_tiled mcf )
+synthetic_benchmarks=( synth_seq synth_stride synth_rand )
+configs=( l1 l1_vc l1_l2 l1_vc_big_l2 )
+config_flags_l1='-v 0 -D'
+config_flags_l1_vc='-D'
+config_flags_l1_l2='-v 0'
+config_flags_l1_vc_big_l2='-C 20 -S 5'
+
+banner() {
+    local message=$1
+    printf '%s\n' "$message"
+    yes = | head -n ${#message} | tr -d '\n'
+    printf '\n'
+}
+
+trace_path() {
+    local benchmark=$1
+
+    if [[ $benchmark == synth_* ]]; then
+        printf '%s' "${synthetic_dir}/${benchmark}.trace"
+    else
+        printf '%s' "traces/${benchmark}.trace"
+    fi
+}
+
+# Deterministic synthetic traces: a sequential stream, a 4KiB stride that
+# lands every access in the same few sets, and uniform random accesses
+# over 64MiB
+generate_synthetic() {
+    local benchmark=$1
+    local path
+    path=$(trace_path "$benchmark")
+
+    [[ -f $path ]] && return 0
+    mkdir -p "$synthetic_dir"
+
+    awk -v n="$synthetic_accesses" -v kind="${benchmark#synth_}" 'BEGIN {
+        srand(4290)
+        for (i = 0; i < n; i++) {
+            if (kind == "seq")
+                addr = 268435456 + i * 8
+            else if (kind == "stride")
+                addr = 536870912 + (i % 512) * 4096 + int(i / 512) % 64 * 8
+            else
+                addr = 805306368 + int(rand() * 67108864)
+            printf "%s 0x%x\n", (rand() < 0.3 ? "W" : "R"), addr
+        }
+    }' >"$path"
+}
+
+# Best of $reps runs, printed as the JSON object from `cachesim -T'
+run_config() {
+    local config=$1
+    local benchmark=$2
+
+    local config_flags_var=config_flags_$config
+    local best=
+    local best_rate=0
+    for ((rep = 0; rep < reps; rep++)); do
+        local result
+        result=$(./run.sh -T ${!config_flags_var} <"$(trace_path "$benchmark")" 2>&1 >/dev/null)
+        local rate
+        rate=$(json_field "$result" accesses_per_sec)
+        if awk -v a="$rate" -v b="$best_rate" 'BEGIN { exit !(a > b) }'; then
+            best=$result
+            best_rate=$rate
+        fi
+    done
+    printf '%s' "$best"
+}
+
+json_field() {
+    local json=$1
+    local field=$2
+
+    printf '%s' "$json" | sed -n 's/.*"'"$field"'": *"\{0,1\}\([^,"}]*\).*/\1/p'
+}
+
+baseline_rate() {
+    local config=$1
+    local benchmark=$2
+
+    [[ -f $baseline_path ]] || return 0
+    local line
+    line=$(grep -F "\"config\": \"$config\", \"trace\": \"$benchmark\"," "$baseline_path" || true)
+    json_field "$line" accesses_per_sec
+}
+
+main() {
+    local update_baseline=0
+    if [[ $1 == --update-baseline || ! -f $baseline_path ]]; then
+        update_baseline=1
+    fi
+
+    local benchmarks=()
+    for benchmark in "${bundled_benchmarks[@]}"; do
+        if [[ -f $(trace_path "$benchmark") ]]; then
+            benchmarks+=( "$benchmark" )
+        fi
+    done
+    for benchmark in "${synthetic_benchmarks[@]}"; do
+        generate_synthetic "$benchmark"
+        benchmarks+=( "$benchmark" )
+    done
+
+    local records=()
+    local regressions=0
+    for config in "${configs[@]}"; do
+        local config_flags_var=config_flags_$config
+        banner "Benchmarking $config (${!config_flags_var:-no flags})..."
+
+        for benchmark in "${benchmarks[@]}"; do
+            local result
+            result=$(run_config "$config" "$benchmark")
+            local rate
+            rate=$(json_field "$result" accesses_per_sec)
+            local base
+            base=$(baseline_rate "$config" "$benchmark")
+
+            printf '==> %-14s %12.0f accesses/s %8.1f ns/access %8s KiB peak RSS' \
+                "$benchmark" "$rate" "$(json_field "$result" ns_per_access)" "$(json_field "$result" peak_rss_kb)"
+            if [[ -n $base && $update_baseline -eq 0 ]]; then
+                local change
+                change=$(awk -v a="$rate" -v b="$base" 'BEGIN { printf "%+.1f", (a - b) / b * 100 }')
+                printf ' (%s%% vs baseline)' "$change"
+                if awk -v a="$rate" -v b="$base" -v t="$threshold" 'BEGIN { exit !(a < b * (1 - t)) }'; then
+                    printf ' REGRESSION'
+                    regressions=$((regressions + 1))
+                fi
+            fi
+            printf '\n'
+
+            records+=( "{\"config\": \"$config\", \"trace\": \"$benchmark\", ${result#\{}" )
+        done
+        printf '\n'
+    done
+
+    {
+        printf '[\n'
+        local i
+        for ((i = 0; i < ${#records[@]}; i++)); do
+            printf '  %s%s\n' "${records[$i]}" "$([[ $i -lt $((${#records[@]} - 1)) ]] && printf ',')"
+        done
+        printf ']\n'
+    } >"$results_path"
+    printf 'Results written to %s\n' "$results_path"
+
+    if [[ $update_baseline -eq 1 ]]; then
+        cp "$results_path" "$baseline_path"
+        printf 'Baseline recorded in %s\n' "$baseline_path"
+    elif [[ $regressions -gt 0 ]]; then
+        printf '%d run(s) more than %.0f%% slower than %s\n' "$regressions" "$(awk -v t="$threshold" 'BEGIN { print t * 100 }')" "$baseline_path"
+        return 1
+    fi
+}
+
+main "$@"
@@ -1,362 +1,669 @@
 #include "cachesim.hpp"
 
 #include <math.h>
-#include <stdlib.h> 
+#include <stdlib.h>
 #include <vector>
 #include <iostream>
 
-static const int addr_size = 64;
+/* low `bits` ones, safe for the full 64-bit width */
+static inline uint64_t bit_mask(int bits) {
+    return bits >= 64 ? ~(uint64_t) 0 : (((uint64_t) 1 << bits) - 1);
+}
+
+/* recency stamps start here so that LIP insertions can count down below every
+ * stamp handed out so far */
+static const uint64_t first_stamp = (uint64_t) 1 << 62;
 
-// struct block {
-//     uint64_t tag, addr;
-//     bool valid, dirty;
-// };
+struct block {
+    uint64_t tag;      /* block address (addr >> b), unique across the whole cache */
+    uint64_t last_use; /* recency stamp, larger is more recently used */
+    uint64_t valid;    /* one bit per sector, an unsectored block only uses bit 0 */
+    uint64_t dirty;    /* one bit per sector */
+    uint64_t next_use; /* index of the next access to the block, only known in opt runs */
+};
 
 struct set {
-    std::vector<uint64_t> lru_stack;
-    std::vector<std::vector<uint64_t>> blocks; /* 0 is addr, 1 is tag, 2 is valid, 3 is dirty */
-    int length;
+    std::vector<block> blocks;
+    set_stats_t stats;
+    int mru_way; /* way prediction guess, the way last accessed */
 
-    set(int _length): length(_length) {
-        lru_stack.resize(_length);
-        blocks.resize(_length);
+    set(int _length): blocks(_length), stats(), mru_way(0) {
         for (int i = 0; i < _length; i++) {
-            blocks[i].resize(4);
-            blocks[i][0] = 0;
-            blocks[i][1] = 0;
-            blocks[i][2] = 0;
-            blocks[i][3] = 0;
-            lru_stack[i] = 0;
+            blocks[i].tag = 0;
+            blocks[i].last_use = 0;
+            blocks[i].valid = 0;
+            blocks[i].dirty = 0;
+            blocks[i].next_use = NO_NEXT_USE;
         }
     }
 };
 
-/* global cache variables */
-std::vector<set> l1_cache;
-std::vector<set> l2_cache;
-std::vector<set> vi_cache;
-
-int block_size, num_offset_bits;
-int l1_num_ways, l1_cache_size, l1_num_sets, l1_num_index_bits, l1_num_tag_bits;
-int l2_num_ways, l2_cache_size, l2_num_sets, l2_num_index_bits, l2_num_tag_bits;
-int vi_num_ways, vi_cache_size, vi_num_tag_bits;
-insert_policy_t l2_insert_policy;
-bool l2_disabled, vi_disabled;
-
-void set_mru(std::vector<uint64_t>& stack, uint64_t tag) {
-	/* temporary array to hold values */
-    std::vector<uint64_t> temp(stack.size() - 1);
-
-	size_t j = 0;
-	for (size_t i = 0; i < stack.size(); i++) {
-        /* special case for lru eviction - won't try to save the lru in the temp array */
-        if (i == j && i == (stack.size() - 1)) {
-            break;
-        }
+struct cache {
+    std::vector<set> sets;
+    std::vector<set_stats_t> set_stats; /* copy handed out by sim_finish */
+    int num_ways, num_sets, num_index_bits;
+    int block_bits, sector_bits;
+    uint64_t prime;
+    index_func_t index_func;
+    insert_policy_t insert_policy;
+    bool way_prediction;
+    uint64_t clock;
+};
 
-		/* only store values that are not MRU in temp array */
-		if (stack[i] != tag) {
-			temp[j] = stack[i];
-			j++;
-		}
-	}
-	
-    /* set n-block to MRU position */
-	stack[0] = tag;
+/* a bandwidth-limited link between levels, serving transfers in arrival order */
+struct link {
+    double bandwidth;  /* bytes per cycle, 0 is unlimited */
+    double busy_until; /* cycle the last transfer finishes */
+};
+
+struct write_buffer_entry {
+    uint64_t tag;    /* block address being combined */
+    uint64_t opened; /* access count when the entry was allocated */
+};
+
+/* global cache variables - each thread simulates its own copy, so set-partitioned
+ * shards of a trace can run side by side */
+thread_local cache l1_cache;
+thread_local cache l2_cache;
+thread_local cache vi_cache;
+
+/* tlbs - caches of page numbers */
+thread_local cache dtlb_cache;
+thread_local cache stlb_cache;
+thread_local bool dtlb_disabled, stlb_disabled;
+thread_local int page_bits, walk_levels;
+
+/* translation cycles of the current access, part of its latency */
+thread_local double translation_time;
+
+/* write-combining buffer in front of l2, oldest entry first */
+thread_local std::vector<write_buffer_entry> write_buffer;
+thread_local uint64_t write_buffer_entries, write_buffer_timeout;
+thread_local double l1_hit_time, l2_hit_time;
+/* lookup times - the first probe finds a block in the predicted way, the full lookup finds it
+ * anywhere else or finds it missing. both are the hit time without way prediction */
+thread_local double l1_first_probe_time, l1_lookup_time, l2_first_probe_time, l2_lookup_time;
+
+/* kept for sim_finish */
+thread_local sim_config_t sim_config;
+
+thread_local bool l2_disabled, vi_disabled, write_buffer_disabled;
+
+/* links below the l1 side and below l2 */
+thread_local link l2_link, dram_link;
+thread_local double access_interval;
+
+/* the l1 block the last access left behind - nothing else touches l1 before the next access, so a
+ * repeat access to the block finds it there without a lookup */
+struct last_block {
+    uint64_t tag;
+    uint64_t index;
+    int way;
+};
+thread_local last_block last_l1;
 
-	/* copy over previous indices, shifted down */
-	for (size_t k = 1; k < stack.size(); k++) {
-		stack[k] = temp[k-1];
-	}
+/* next use of the block the current access touches, for opt caches */
+thread_local uint64_t next_use = NO_NEXT_USE;
+
+/* when set, requests leaving the l1 side go here instead of into l2 */
+thread_local l2_hook_t l2_hook;
+thread_local void *l2_hook_arg;
+
+/* xor every `bits`-wide slice of x together */
+static uint64_t xor_fold(uint64_t x, int bits) {
+    if (bits == 0) return 0;
+    if (bits >= 64) return x;
+
+    uint64_t folded = 0;
+    for (; x; x >>= bits) {
+        folded ^= x & bit_mask(bits);
+    }
+    return folded;
 }
 
-void set_lru(std::vector<uint64_t>& stack, uint64_t tag) {
-	/* temporary array to hold values */
-    std::vector<uint64_t> temp(stack.size() - 1);
+/* rotate the low `bits` bits of x left by r */
+static uint64_t rotate_left(uint64_t x, int r, int bits) {
+    if (bits == 0) return 0;
+    r %= bits;
+    if (r == 0) return x;
+    return ((x << r) | (x >> (bits - r))) & bit_mask(bits);
+}
 
-	size_t j = 0;
-	for (size_t i = 0; i < stack.size(); i++) {
-        /* special case for lru eviction - won't try to save the lru in the temp array */
-        if (i == j && i == (stack.size() - 1)) {
-            break;
+/* largest prime no greater than n, or 1 if there is none */
+static uint64_t prev_prime(uint64_t n) {
+    for (; n > 2; n--) {
+        bool prime = true;
+        for (uint64_t d = 2; d * d <= n; d++) {
+            if (n % d == 0) {
+                prime = false;
+                break;
+            }
         }
+        if (prime) return n;
+    }
+    return n < 2 ? 1 : 2;
+}
 
-		/* only store values that are not LRU in temp array */
-		if (stack[i] != tag) {
-			temp[j] = stack[i];
-			j++;
-		}
-	}
-	
-    /* set n-block to LRU position */
-	stack[stack.size() - 1] = tag;
-
-	/* copy over previous indices, shifted down */
-	for (size_t k = 0; k < stack.size() - 1; k++) {
-		stack[k] = temp[k];
-	}
+/* set a block address maps to; only skewed caches look at the way */
+static inline uint64_t cache_index(cache& c, uint64_t tag, int way) {
+    switch (c.index_func) {
+        case INDEX_FUNC_XOR:
+            return xor_fold(tag, c.num_index_bits);
+        case INDEX_FUNC_PRIME:
+            return tag % c.prime;
+        case INDEX_FUNC_SKEW:
+            /* low index bits xor a per-way rotation of everything above them */
+            return (tag & bit_mask(c.num_index_bits))
+                ^ rotate_left(xor_fold(tag >> c.num_index_bits, c.num_index_bits), way, c.num_index_bits);
+        case INDEX_FUNC_MODULO:
+        default:
+            return tag & bit_mask(c.num_index_bits);
+    }
 }
 
-void popoff_stack(std::vector<uint64_t>& stack, uint64_t tag) {
-    /* remove hit block from victim lru stack */
-    for (size_t i = 0; i < stack.size(); i++) {
-        if (stack[i] == tag) {
-            stack[i] = 0;
-            break;
+/* returns the way holding tag (and its set through index), or -1 on a miss */
+static int cache_find(cache& c, uint64_t tag, uint64_t *index) {
+    if (c.index_func == INDEX_FUNC_SKEW) {
+        for (int way = 0; way < c.num_ways; way++) {
+            uint64_t i = cache_index(c, tag, way);
+            if (c.sets[i].blocks[way].valid && c.sets[i].blocks[way].tag == tag) {
+                *index = i;
+                return way;
+            }
         }
+        return -1;
     }
 
-    /* temporary array to hold values */
-    std::vector<uint64_t> temp(stack.size());
+    *index = cache_index(c, tag, 0);
+    std::vector<block>& blocks = c.sets[*index].blocks;
+    for (int way = 0; way < c.num_ways; way++) {
+        if (blocks[way].valid && blocks[way].tag == tag) return way;
+    }
+    return -1;
+}
 
-    /* move all 0 spots to bottom of stack */
-    size_t j = 0;
-    for (size_t i = 0; i < stack.size(); i++) {
-        if (stack[i] != 0) {
-            temp[j] = stack[i];
-            j++;
+/* returns the way a new block with this tag replaces (and its set through
+ * index): the first open block, otherwise the lru */
+static int cache_victim(cache& c, uint64_t tag, uint64_t *index) {
+    int lru_way = -1;
+    uint64_t lru_index = 0;
+    for (int way = 0; way < c.num_ways; way++) {
+        uint64_t i = cache_index(c, tag, way);
+        block& b = c.sets[i].blocks[way];
+        if (!b.valid) {
+            *index = i;
+            return way;
+        }
+        if (lru_way < 0 || b.last_use < c.sets[lru_index].blocks[lru_way].last_use) {
+            lru_way = way;
+            lru_index = i;
         }
     }
+    *index = lru_index;
+    return lru_way;
+}
+
+/* set a block to mru - opt ranks blocks by next use instead, the farthest one taking the lru
+ * position, so the lru search above finds the opt victim */
+static inline void cache_touch(cache& c, uint64_t index, int way) {
+    block& b = c.sets[index].blocks[way];
+    b.last_use = c.insert_policy == INSERT_POLICY_OPT ? ~b.next_use : ++c.clock;
 }
 
-uint64_t get_lru(std::vector<uint64_t>& stack) {
-    /* loop until end of valid tags and return index */
-    size_t i;
-    for (i = 0; i < stack.size(); i++) {
-        if (stack[i] == 0) break;
+/* place a block with the given sectors, at the mru or lru position depending on insertion policy */
+static void cache_fill(cache& c, uint64_t index, int way, uint64_t tag, uint64_t valid, uint64_t dirty,
+                       uint64_t next) {
+    block& b = c.sets[index].blocks[way];
+    b.tag = tag;
+    b.valid = valid;
+    b.dirty = dirty;
+    b.next_use = next;
+
+    if (c.insert_policy != INSERT_POLICY_LIP) {
+        cache_touch(c, index, way);
+        return;
+    }
+
+    /* lip - place below every other valid block this one competes with */
+    uint64_t lru_stamp = 0;
+    bool found = false;
+    for (int w = 0; w < c.num_ways; w++) {
+        if (w == way) continue;
+        uint64_t i = (c.index_func == INDEX_FUNC_SKEW) ? cache_index(c, tag, w) : index;
+        block& other = c.sets[i].blocks[w];
+        if (other.valid && (!found || other.last_use < lru_stamp)) {
+            lru_stamp = other.last_use;
+            found = true;
+        }
+    }
+    if (found) {
+        b.last_use = lru_stamp - 1;
+    }
+    else {
+        cache_touch(c, index, way);
     }
-    return stack[i - 1];
 }
 
-int available(std::vector<std::vector<uint64_t>>& set) {
-    /* return index on first open block */
-    for (size_t i = 0; i < set.size(); i++) {
-        if (!set[i][2]) return i;
+/* mru way prediction for a lookup of tag that finds it in way (and set index) - returns whether
+ * the predictor guessed that way, and makes it the next guess. skewed caches have no single set, so
+ * their predictor entry is the row of the first way */
+static inline bool way_predict(cache& c, uint64_t tag, uint64_t index, int way) {
+    if (!c.way_prediction) {
+        return false;
     }
-    /* return -1 for no open blocks */
-    return -1;
+    set& s = c.sets[c.index_func == INDEX_FUNC_SKEW ? cache_index(c, tag, 0) : index];
+    bool predicted = s.mru_way == way;
+    s.mru_way = way;
+    return predicted;
 }
 
-/* subroutine for initializing the cache simulator */
-void sim_setup(sim_config_t *config) {
-    /* initialize l1 global cache config values */
-    block_size = pow(2, config->l1_config.b);
-    num_offset_bits = config->l1_config.b;
+/* count a block being replaced in set index of c, and keep track of the blocks evicted most */
+static void cache_evicted(cache& c, uint64_t index, const block& evicted) {
+    if (!evicted.valid) {
+        return;
+    }
 
-    l1_num_ways = pow(2, config->l1_config.s);
-    l1_cache_size = pow(2, config->l1_config.c);
-    l1_num_sets = l1_cache_size / block_size / l1_num_ways;
-    l1_num_index_bits = config->l1_config.c - config->l1_config.s - config->l1_config.b;
-    l1_num_tag_bits = addr_size - (l1_num_index_bits + num_offset_bits);
+    set_stats_t& stats = c.sets[index].stats;
+    uint64_t addr = evicted.tag << c.block_bits;
+    int min = 0;
+    stats.evictions++;
+    for (int i = 0; i < SET_STATS_TOP_BLOCKS; i++) {
+        if (stats.top_blocks[i].count && stats.top_blocks[i].addr == addr) {
+            stats.top_blocks[i].count++;
+            return;
+        }
+        if (stats.top_blocks[i].count < stats.top_blocks[min].count) {
+            min = i;
+        }
+    }
+    stats.top_blocks[min].addr = addr;
+    stats.top_blocks[min].count++;
+}
 
-    for (int i = 0; i < l1_num_sets; i++) {
-        l1_cache.push_back(set(l1_num_ways));
+/* sectors of c covering the aligned 2^bits bytes around addr */
+static uint64_t sector_mask(cache& c, uint64_t addr, int bits) {
+    int num_sectors_bits = c.block_bits - c.sector_bits;
+    if (bits >= c.block_bits) {
+        return bit_mask(1 << num_sectors_bits);
+    }
+    if (bits <= c.sector_bits) {
+        return (uint64_t) 1 << ((addr >> c.sector_bits) & bit_mask(num_sectors_bits));
     }
+    uint64_t first = ((addr >> bits) << (bits - c.sector_bits)) & bit_mask(num_sectors_bits);
+    return bit_mask(1 << (bits - c.sector_bits)) << first;
+}
 
-    /* initialize l2 global cache config values */
-    l2_disabled = config->l2_config.disabled;
-    if (!l2_disabled) {
-        l2_num_ways = pow(2, config->l2_config.s);
-        l2_cache_size = pow(2, config->l2_config.c);
-        l2_num_sets = l2_cache_size / block_size / l2_num_ways;
-        l2_num_index_bits = config->l2_config.c - config->l2_config.s - config->l2_config.b;
-        l2_num_tag_bits = addr_size - (l2_num_index_bits + num_offset_bits);
-        l2_insert_policy = config->l2_config.insert_policy;
+/* bytes held by the sectors in mask */
+static inline uint64_t sector_bytes(cache& c, uint64_t mask) {
+    return (uint64_t) __builtin_popcountll(mask) << c.sector_bits;
+}
 
-        for (int i = 0; i < l2_num_sets; i++) {
-            l2_cache.push_back(set(l2_num_ways));
-        }
+static void cache_init(cache& c, int num_ways, int num_sets, int num_index_bits, cache_config_t *config) {
+    c.num_ways = num_ways;
+    c.num_sets = num_sets;
+    c.num_index_bits = num_index_bits;
+    c.block_bits = config->b;
+    c.sector_bits = config->sector_b ? config->sector_b : config->b;
+    c.index_func = config->index_func;
+    c.insert_policy = config->insert_policy;
+    c.way_prediction = config->way_prediction;
+    c.prime = prev_prime(num_sets);
+    c.clock = first_stamp;
+
+    for (int i = 0; i < num_sets; i++) {
+        c.sets.push_back(set(num_ways));
     }
+}
 
-    /* initialize victim global cache config values */
-    vi_disabled = !(config->victim_cache_entries);
-    if (!vi_disabled) {
-        vi_num_ways = config->victim_cache_entries;
-        vi_cache_size = block_size * vi_num_ways;
-        vi_num_tag_bits = addr_size - num_offset_bits;
-        vi_cache.push_back(set(vi_num_ways));
-        // std::cout << vi_cache.size() << std::endl;
-        // std::cout << vi_cache[0].blocks.size() << std::endl;
-        // std::cout << vi_cache[0].blocks[0].size() << std::endl;
+static void tlb_init(cache& c, tlb_config_t *config, int page_b) {
+    cache_config_t tlb_config = {0, config->e + page_b, (uint64_t) page_b, config->s, INSERT_POLICY_MIP,
+                                 WRITE_STRAT_WBWA, INDEX_FUNC_MODULO, 0, 0};
+    cache_init(c, 1 << config->s, 1 << (config->e - config->s), config->e - config->s, &tlb_config);
+}
+
+/* move bytes over l at the arrival of access now (the l1 access count) - the transfer waits for
+ * whatever is still on the link. returns the cycles it waited */
+static double link_transfer(link& l, uint64_t bytes, uint64_t now, double *queue_cycles, double *busy_cycles) {
+    if (!l.bandwidth || !bytes) {
+        return 0;
     }
+
+    double arrival = (now - 1) * access_interval;
+    double start = arrival > l.busy_until ? arrival : l.busy_until;
+    double service = bytes / l.bandwidth;
+    *queue_cycles += start - arrival;
+    *busy_cycles += service;
+    l.busy_until = start + service;
+    return start - arrival;
 }
 
-/* subroutine that simulates the cache one trace event at a time */
-void sim_access(char rw, uint64_t addr, sim_stats_t* stats) {
-    /* get tag, index */
-    uint64_t l1_tag = (addr >> (l1_num_index_bits + num_offset_bits)) & ((1 << l1_num_tag_bits) - 1);
-    uint64_t l1_index = (addr >> num_offset_bits) & ((1 << l1_num_index_bits) - 1);
+/* histogram bucket of a latency in LATENCY_UNITS_PER_CYCLE units - exact below 2^LATENCY_SUB_BITS,
+ * then 2^LATENCY_SUB_BITS buckets per power of two */
+static int latency_bucket(uint64_t value) {
+    if (value >> LATENCY_SUB_BITS == 0) {
+        return value;
+    }
+    int shift = 63 - __builtin_clzll(value) - LATENCY_SUB_BITS;
+    return ((shift + 1) << LATENCY_SUB_BITS) + ((value >> shift) & bit_mask(LATENCY_SUB_BITS));
+}
 
-    /* increment l1 accesses */
-    stats->accesses_l1++;
+/* largest latency that falls into bucket i */
+static uint64_t latency_bucket_max(int i) {
+    if (i >> LATENCY_SUB_BITS == 0) {
+        return i;
+    }
+    int shift = (i >> LATENCY_SUB_BITS) - 1;
+    uint64_t low = (uint64_t) ((1 << LATENCY_SUB_BITS) + (i & bit_mask(LATENCY_SUB_BITS))) << shift;
+    return low + bit_mask(shift);
+}
 
-    /* search l1 cache for tag */
-    bool hit = false;
-    int hit_block;
-    for (hit_block = 0; hit_block < l1_num_ways; hit_block++) {
-        if (l1_cache[l1_index].blocks[hit_block][1] == l1_tag && l1_cache[l1_index].blocks[hit_block][2]) {
-            hit = true;
-            break;
-        }
+/* count accesses that each took cycles, plus the time translating their address */
+static void latency_record(double cycles, uint64_t count, sim_stats_t *stats) {
+    uint64_t value = llround((cycles + translation_time) * LATENCY_UNITS_PER_CYCLE);
+    stats->latency_total += value * count;
+    if (value > stats->latency_max) {
+        stats->latency_max = value;
     }
+    stats->latency_histogram[latency_bucket(value)] += count;
+}
 
-    /* l1 cache hit */
-    if (hit) {
-        /* increment hits */
-        stats->hits_l1++;
+/* send buffered entry i to l2 as a single write */
+static void write_buffer_drain(size_t i, uint64_t *reason, sim_stats_t *stats) {
+    write_buffer.erase(write_buffer.begin() + i);
+    stats->writes_l2++;
+    stats->drains_write_buffer++;
+    (*reason)++;
+}
 
-        /* determine if read or write */
-        if (rw == WRITE) {
-            /* set dirty bit */
-            l1_cache[l1_index].blocks[hit_block][3] = true;
+/* drain entries that have been open for the timeout, oldest first - now is the l1 access count */
+static void write_buffer_expire(uint64_t now, sim_stats_t *stats) {
+    while (write_buffer_timeout && !write_buffer.empty()
+           && now - write_buffer[0].opened >= write_buffer_timeout) {
+        write_buffer_drain(0, &stats->timeout_drains_write_buffer, stats);
+    }
+}
 
-            /* increment writes */
-            stats->writes++;
-        }
-        else {
-            /* increment reads */
-            stats->reads++;
-        }
+static int write_buffer_find(uint64_t tag) {
+    for (size_t i = 0; i < write_buffer.size(); i++) {
+        if (write_buffer[i].tag == tag) return i;
+    }
+    return -1;
+}
 
-        /* set hit block to MRU */
-        set_mru(l1_cache[l1_index].lru_stack, l1_tag);
+/* a write on its way to l2 - merge it, or open an entry (stalling on a full buffer) */
+static void write_buffer_write(uint64_t tag, uint64_t now, sim_stats_t *stats) {
+    write_buffer_expire(now, stats);
 
+    if (write_buffer_find(tag) >= 0) {
+        stats->writes_absorbed_write_buffer++;
         return;
     }
 
-    /* function did not return, increment l1 misses */
-    stats->misses_l1++;
-    
-    /* check if victim cache is enabled */
-    uint64_t vi_tag;
-    if (!vi_disabled) {
-        /* update tag */
-        vi_tag = (addr >> num_offset_bits) & ((1 << vi_num_tag_bits) - 1);
-
-        // std::cout << std::endl << "CAN I KICK IT?! " << vi_tag << std::endl << "victim blocks - " << std::endl;
-        // for (int i = 0; i < vi_num_ways; i++) {
-        //     std::cout << vi_cache[0].blocks[i][1] << std::endl;
-        // }
-        // std::cout << "lru stack - " << std::endl;
-        // for (int i = 0; i < vi_num_ways; i++) {
-        //     std::cout << vi_cache[0].lru_stack[i] << std::endl;
-        // }
-        // std::cout << std::endl;
+    if (write_buffer.size() == write_buffer_entries) {
+        write_buffer_drain(0, &stats->capacity_drains_write_buffer, stats);
+        stats->stall_cycles_write_buffer += l2_hit_time;
+    }
 
-        /* search victim cache for tag */
-        for (hit_block = 0; hit_block < vi_num_ways; hit_block++) {
-            if (vi_cache[0].blocks[hit_block][1] == vi_tag && vi_cache[0].blocks[hit_block][2]) {
-                hit = true;
-                break;
-            }
+    write_buffer_entry entry = {tag, now};
+    write_buffer.push_back(entry);
+}
+
+/* a read on its way to l2 - a buffered write to the same block has to reach l2 first */
+static void write_buffer_read(uint64_t tag, uint64_t now, sim_stats_t *stats) {
+    write_buffer_expire(now, stats);
+
+    int i = write_buffer_find(tag);
+    if (i >= 0) {
+        write_buffer_drain(i, &stats->conflict_drains_write_buffer, stats);
+        stats->stall_cycles_write_buffer += l2_hit_time;
+    }
+}
+
+/* a page table entry read by the page walker. it goes straight to l2 (or DRAM without one) and
+ * stays there, as the walker has no l1 to move it into. returns its latency */
+static double l2_walk_read(uint64_t addr, uint64_t now, sim_stats_t *stats) {
+    stats->walk_references++;
+    if (l2_disabled) {
+        stats->walk_references_dram++;
+        stats->bytes_read_dram += (uint64_t) 1 << l1_cache.sector_bits;
+        return DRAM_ACCESS_PENALTY + link_transfer(dram_link, (uint64_t) 1 << l1_cache.sector_bits, now,
+                                                   &stats->queue_cycles_dram, &stats->busy_cycles_dram);
+    }
+
+    uint64_t tag = addr >> l2_cache.block_bits;
+    uint64_t needed = sector_mask(l2_cache, addr, l1_cache.sector_bits);
+    uint64_t index;
+    int way = cache_find(l2_cache, tag, &index);
+    uint64_t present = way >= 0 ? l2_cache.sets[index].blocks[way].valid & needed : 0;
+    bool predicted = way >= 0 && way_predict(l2_cache, tag, index, way);
+    double latency = present == needed && predicted ? l2_first_probe_time : l2_lookup_time;
+    if (present != needed) {
+        stats->walk_references_dram++;
+        stats->bytes_read_dram += sector_bytes(l2_cache, needed & ~present);
+        latency += DRAM_ACCESS_PENALTY;
+        latency += link_transfer(dram_link, sector_bytes(l2_cache, needed & ~present), now,
+                                 &stats->queue_cycles_dram, &stats->busy_cycles_dram);
+
+        /* the entry is filled into l2 like an l1 victim would be */
+        if (way < 0) {
+            way = cache_victim(l2_cache, tag, &index);
+            cache_evicted(l2_cache, index, l2_cache.sets[index].blocks[way]);
+            cache_fill(l2_cache, index, way, tag, needed, 0, NO_NEXT_USE);
+            way_predict(l2_cache, tag, index, way);
+            return latency;
         }
+        l2_cache.sets[index].blocks[way].valid |= needed;
+    }
+    cache_touch(l2_cache, index, way);
+    return latency;
+}
 
-        /* victim cache hit */
-        if (hit) {
-            /* increment hits */
-            stats->hits_victim_cache++;
+/* look up the page of addr, returning the cycles translation adds to the access: none on a dtlb hit,
+ * the stlb hit time on a dtlb miss, and the page walk on top of that on an stlb miss. every level
+ * of the walk depends on the entry read from the one above, so their latencies add up */
+static double tlb_translate(uint64_t addr, uint64_t now, sim_stats_t *stats) {
+    uint64_t page = addr >> page_bits;
+    uint64_t index;
+    stats->accesses_dtlb++;
+    int way = cache_find(dtlb_cache, page, &index);
+    if (way >= 0) {
+        cache_touch(dtlb_cache, index, way);
+        return 0;
+    }
+    stats->misses_dtlb++;
+
+    double cycles = 0;
+    bool walk = true;
+    if (!stlb_disabled) {
+        cycles += STLB_HIT_TIME;
+        uint64_t stlb_index;
+        int stlb_way = cache_find(stlb_cache, page, &stlb_index);
+        if (stlb_way >= 0) {
+            cache_touch(stlb_cache, stlb_index, stlb_way);
+            walk = false;
+        }
+        else {
+            stats->misses_stlb++;
+            stlb_way = cache_victim(stlb_cache, page, &stlb_index);
+            cache_fill(stlb_cache, stlb_index, stlb_way, page, 1, 0, NO_NEXT_USE);
+        }
+    }
 
-            /* determine if read or write */
-            if (rw == WRITE) {
-                /* set dirty bit */
-                vi_cache[0].blocks[hit_block][3] = true;
+    if (walk) {
+        stats->page_walks++;
+        uint64_t va = addr & bit_mask(VIRTUAL_ADDRESS_BITS);
+        for (int level = 0; level < walk_levels; level++) {
+            int shift = page_bits + PAGE_TABLE_INDEX_BITS * (walk_levels - 1 - level);
+            uint64_t entry = PAGE_TABLE_BASE + ((uint64_t) level << VIRTUAL_ADDRESS_BITS)
+                + (va >> shift) * PAGE_TABLE_ENTRY_BYTES;
+            cycles += l2_walk_read(entry, now, stats);
+        }
+    }
 
-                /* increment writes */
-                stats->writes++;
-            }
-            else {
-                /* increment reads */
-                stats->reads++;
-            }
+    way = cache_victim(dtlb_cache, page, &index);
+    cache_fill(dtlb_cache, index, way, page, 1, 0, NO_NEXT_USE);
+    stats->translation_cycles += cycles;
+    return cycles;
+}
 
-            /* see if set in l1 has empty spots */
-            int open_block = available(l1_cache[l1_index].blocks);
-            if (open_block < 0) {
-                // std::cout << "NO FREE LUNCH " << vi_tag << std::endl;
-                /* no open spots in l1 set, must evict - get the lru for the hit block's set in l1 */
-                uint64_t l1_lru_tag = get_lru(l1_cache[l1_index].lru_stack);
-
-                /* swap actual blocks in victim and l1 */
-                for (int i = 0; i < l1_num_ways; i++) {
-                    if (l1_cache[l1_index].blocks[i][1] == l1_lru_tag && l1_cache[l1_index].blocks[i][2]) {
-                        /* exchange block info */
-                        int temp_hit_dirty = vi_cache[0].blocks[hit_block][3];
-
-                        vi_cache[0].blocks[hit_block][3] = l1_cache[l1_index].blocks[i][3];
-                        vi_cache[0].blocks[hit_block][1] = (l1_cache[l1_index].blocks[i][0] >> num_offset_bits) & ((1 << vi_num_tag_bits) - 1);
-                        vi_cache[0].blocks[hit_block][2] = true;
-                        vi_cache[0].blocks[hit_block][0] = l1_cache[l1_index].blocks[i][0];
-
-                        l1_cache[l1_index].blocks[i][3] = temp_hit_dirty;
-                        l1_cache[l1_index].blocks[i][2] = true;
-                        l1_cache[l1_index].blocks[i][1] = l1_tag;
-                        l1_cache[l1_index].blocks[i][0] = addr;
-
-                        break;
-                    }
-                }
+/* subroutine for initializing the cache simulator */
+void sim_setup(sim_config_t *config) {
+    sim_config = *config;
 
-                /* remove evicted block from l1 lru stack */
-                popoff_stack(l1_cache[l1_index].lru_stack, l1_lru_tag);
+    /* initialize l1 global cache config values */
+    int l1_num_ways = pow(2, config->l1_config.s);
+    int l1_cache_size = pow(2, config->l1_config.c);
+    int l1_num_sets = l1_cache_size / (int) pow(2, config->l1_config.b) / l1_num_ways;
+    int l1_num_index_bits = config->l1_config.c - config->l1_config.s - config->l1_config.b;
+    cache_init(l1_cache, l1_num_ways, l1_num_sets, l1_num_index_bits, &config->l1_config);
+    l1_hit_time = L1_HIT_TIME_CONST + L1_HIT_TIME_PER_S * config->l1_config.s;
+    l1_first_probe_time = config->l1_config.way_prediction ? L1_HIT_TIME_CONST : l1_hit_time;
+    l1_lookup_time = config->l1_config.way_prediction ? L1_HIT_TIME_CONST + l1_hit_time : l1_hit_time;
+    last_l1.tag = ~(uint64_t) 0; /* tags are at most 60 bits */
 
-                /* remove hit block from victim lru stack */
-                popoff_stack(vi_cache[0].lru_stack, vi_tag);
+    /* initialize l2 global cache config values */
+    l2_disabled = config->l2_config.disabled;
+    if (!l2_disabled) {
+        int l2_num_ways = pow(2, config->l2_config.s);
+        int l2_cache_size = pow(2, config->l2_config.c);
+        int l2_num_sets = l2_cache_size / (int) pow(2, config->l2_config.b) / l2_num_ways;
+        int l2_num_index_bits = config->l2_config.c - config->l2_config.s - config->l2_config.b;
+        cache_init(l2_cache, l2_num_ways, l2_num_sets, l2_num_index_bits, &config->l2_config);
+        l2_hit_time = L2_HIT_TIME_CONST + L2_HIT_TIME_PER_S * config->l2_config.s;
+        l2_first_probe_time = config->l2_config.way_prediction ? L2_HIT_TIME_CONST : l2_hit_time;
+        l2_lookup_time = config->l2_config.way_prediction ? L2_HIT_TIME_CONST + l2_hit_time : l2_hit_time;
+    }
 
-                /* swap tags in victim and l1 lru stacks */
-                // if (vi_cache[0].blocks[hit_block][1] == 35234205) std::cout << "FLAG 289" << std::endl;
-                set_mru(vi_cache[0].lru_stack, vi_cache[0].blocks[hit_block][1]);
-                set_mru(l1_cache[l1_index].lru_stack, l1_tag);
+    /* write-combining only applies to a write-through l2 */
+    write_buffer_entries = config->write_buffer_entries;
+    write_buffer_timeout = config->write_buffer_timeout;
+    write_buffer_disabled = l2_disabled || !write_buffer_entries
+        || config->l2_config.write_strat != WRITE_STRAT_WTWNA;
+
+    /* queueing on the links below l1 */
+    l2_link.bandwidth = config->l2_bandwidth;
+    l2_link.busy_until = 0;
+    dram_link.bandwidth = config->dram_bandwidth;
+    dram_link.busy_until = 0;
+    access_interval = config->access_interval;
+
+    /* tlbs hold one page per entry */
+    dtlb_disabled = config->dtlb_config.disabled;
+    stlb_disabled = dtlb_disabled || config->stlb_config.disabled;
+    page_bits = config->page_b;
+    walk_levels = (VIRTUAL_ADDRESS_BITS - page_bits + PAGE_TABLE_INDEX_BITS - 1) / PAGE_TABLE_INDEX_BITS;
+    translation_time = 0;
+    if (!dtlb_disabled) {
+        tlb_init(dtlb_cache, &config->dtlb_config, page_bits);
+    }
+    if (!stlb_disabled) {
+        tlb_init(stlb_cache, &config->stlb_config, page_bits);
+    }
 
-                return;
-            }
-            else {
-                /* open spot available, save hit block in l1 */
-                l1_cache[l1_index].blocks[open_block][1] = l1_tag;
-                l1_cache[l1_index].blocks[open_block][0] = addr;
-                l1_cache[l1_index].blocks[open_block][3] = vi_cache[0].blocks[hit_block][3];
-                l1_cache[l1_index].blocks[open_block][2] = true;
+    /* initialize victim global cache config values - one fully associative lru set of l1 blocks */
+    vi_disabled = !(config->victim_cache_entries);
+    if (!vi_disabled) {
+        cache_config_t vi_config = config->l1_config;
+        vi_config.insert_policy = INSERT_POLICY_MIP;
+        vi_config.index_func = INDEX_FUNC_MODULO;
+        cache_init(vi_cache, config->victim_cache_entries, 1, 0, &vi_config);
+    }
+}
 
-                /* remove hit block from victim lru stack */
-                // if (vi_tag == 35234205) std::cout << "FLAG 303" << std::endl;
-                popoff_stack(vi_cache[0].lru_stack, vi_tag);
+/* an l1 block leaving the l1 side (l1 and victim cache) - it moves into l2 if enabled, otherwise
+ * its dirty sectors are written back to DRAM */
+static void l2_insert(block& evicted, uint64_t now, sim_stats_t* stats) {
+    if (l2_disabled) {
+        stats->bytes_written_dram += sector_bytes(l1_cache, evicted.dirty);
+        link_transfer(dram_link, sector_bytes(l1_cache, evicted.dirty), now, &stats->queue_cycles_dram,
+                      &stats->busy_cycles_dram);
+        return;
+    }
 
-                /* remove hit block from victim block list */
-                vi_cache[0].blocks[hit_block][2] = 0;
+    /* l2 blocks are at least as large as l1 blocks, so the victim lands in a single l2 block */
+    uint64_t base = evicted.tag << l1_cache.block_bits;
+    uint64_t tag = base >> l2_cache.block_bits;
+    uint64_t valid = 0;
+    for (uint64_t sectors = evicted.valid; sectors; sectors &= sectors - 1) {
+        uint64_t offset = (uint64_t) __builtin_ctzll(sectors) << l1_cache.sector_bits;
+        valid |= sector_mask(l2_cache, base + offset, l1_cache.sector_bits);
+    }
 
-                /* set incoming hit block to mru in l1 */
-                set_mru(l1_cache[l1_index].lru_stack, l1_tag);
-            }
-        }
+    /* merge with the rest of the l2 block if it is present, otherwise find an open block or
+     * evict the lru (which would be saved to DRAM here) */
+    uint64_t victim_index;
+    uint64_t next = evicted.next_use;
+    int l2_victim = cache_find(l2_cache, tag, &victim_index);
+    if (l2_victim >= 0) {
+        block& merged = l2_cache.sets[victim_index].blocks[l2_victim];
+        valid |= merged.valid;
+        next = merged.next_use < next ? merged.next_use : next;
     }
+    else {
+        l2_victim = cache_victim(l2_cache, tag, &victim_index);
+        cache_evicted(l2_cache, victim_index, l2_cache.sets[victim_index].blocks[l2_victim]);
+    }
+    cache_fill(l2_cache, victim_index, l2_victim, tag, valid, 0, next);
+    way_predict(l2_cache, tag, victim_index, l2_victim);
+
+    /* increment write backs as victim block is no longer dirty in l2 - write-through carries its
+     * dirty sectors on to DRAM */
+    stats->write_backs_l1_or_victim_cache++;
+    stats->bytes_written_l2 += sector_bytes(l1_cache, evicted.valid);
+    stats->bytes_written_dram += sector_bytes(l1_cache, evicted.dirty);
+    link_transfer(l2_link, sector_bytes(l1_cache, evicted.valid), now, &stats->queue_cycles_l2,
+                  &stats->busy_cycles_l2);
+    link_transfer(dram_link, sector_bytes(l1_cache, evicted.dirty), now, &stats->queue_cycles_dram,
+                  &stats->busy_cycles_dram);
+}
 
-    /* victim cache disabled or function did not return, increment victim misses */
-    stats->misses_victim_cache++;
+/* a sector missed in l1 and the victim cache - look it up in l2. now is the l1 access count,
+ * write buffer timeouts are measured in l1 accesses */
+static void l2_access(char rw, uint64_t addr, uint64_t now, sim_stats_t* stats) {
+    /* the access already spent the l1 lookup time finding out it missed, and any write buffer
+     * stalls below hold it up too */
+    double latency = l1_lookup_time;
+    double stalled = stats->stall_cycles_write_buffer;
 
     /* check if l2 cache is enabled */
-    uint64_t l2_tag, l2_index;
+    bool l2_hit = false;
     if (!l2_disabled) {
-        /* increment r/w request stats */
+        /* the l2 block and sectors holding the l1 sector being fetched */
+        uint64_t l2_tag = addr >> l2_cache.block_bits;
+        uint64_t needed = sector_mask(l2_cache, addr, l1_cache.sector_bits);
+
+        /* increment r/w request stats - writes are counted once they leave the write buffer, if enabled */
         if (rw == WRITE) {
-            stats->writes_l2++;
+            if (write_buffer_disabled) {
+                stats->writes_l2++;
+            }
+            else {
+                write_buffer_write(l2_tag, now, stats);
+            }
         }
         else {
             stats->reads_l2++;
+            if (!write_buffer_disabled) {
+                write_buffer_read(l2_tag, now, stats);
+            }
         }
 
-        /* update tag, index */
-        l2_tag = (addr >> (l2_num_index_bits + num_offset_bits)) & ((1 << l2_num_tag_bits) - 1);
-        l2_index = (addr >> num_offset_bits) & ((1 << l2_num_index_bits) - 1);
-
         /* search l2 cache for tag */
-        for (hit_block = 0; hit_block < l2_num_ways; hit_block++) {
-            if (l2_cache[l2_index].blocks[hit_block][1] == l2_tag && l2_cache[l2_index].blocks[hit_block][2]) {
-                hit = true;
-                break;
-            }
+        uint64_t l2_index;
+        int hit_block = cache_find(l2_cache, l2_tag, &l2_index);
+        uint64_t present = 0;
+        if (hit_block >= 0) {
+            /* remove the needed sectors from l2, they move up into l1 */
+            present = l2_cache.sets[l2_index].blocks[hit_block].valid & needed;
+            l2_cache.sets[l2_index].blocks[hit_block].valid &= ~needed;
         }
+        bool predicted = hit_block >= 0 && way_predict(l2_cache, l2_tag, l2_index, hit_block);
+        latency += hit_block >= 0 && present == needed && predicted ? l2_first_probe_time : l2_lookup_time;
 
         /* l2 cache hit */
-        if (hit) {
+        if (hit_block >= 0 && present == needed) {
+            l2_hit = true;
+
             /* determine if read or write */
             if (rw == WRITE) {
                 /* increment writes */
@@ -368,416 +675,514 @@ void sim_access(char rw, uint64_t addr, sim_stats_t* stats) {
 
                 /* increment l2 read hits */
                 stats->read_hits_l2++;
+                stats->way_predicted_read_hits_l2 += predicted;
             }
+        }
+        else {
+            /* skewed caches have no single set for a miss, charge the row it would be filled into */
+            if (hit_block < 0 && l2_cache.index_func == INDEX_FUNC_SKEW) {
+                cache_victim(l2_cache, l2_tag, &l2_index);
+            }
+            l2_cache.sets[l2_index].stats.misses++;
 
-            /* pop off hit block from l2 lru stack, set as new l1 mru */
-            popoff_stack(l2_cache[l2_index].lru_stack, l2_tag);
-            
-            /* remove hit block from l2 */
-            l2_cache[l2_index].blocks[hit_block][2] = false;
-
-            /* check if there are open spots in l1 set for l2 hit block */
-            int open_block = available(l1_cache[l1_index].blocks);
-            uint64_t l1_evicted_addr;
-            bool l1_evicted_dirty;
-            if (open_block < 0) {
-                /* no spots available, get l1 lru tag */
-                uint64_t l1_lru_tag = get_lru(l1_cache[l1_index].lru_stack);
-
-                /* get index of l1 lru in blocks */
-                int l1_lru;
-                for (l1_lru = 0; l1_lru < l1_num_ways; l1_lru++) {
-                    if (l1_cache[l1_index].blocks[l1_lru][1] == l1_lru_tag) break;
-                }
-
-                /* bring in l2 hit, evict l1 lru to victim (if enabled) */
-                l1_evicted_addr = l1_cache[l1_index].blocks[l1_lru][0];
-                l1_evicted_dirty = l1_cache[l1_index].blocks[l1_lru][3];
+            /* missing l2 sectors come from DRAM */
+            stats->bytes_read_dram += sector_bytes(l2_cache, needed & ~present);
+            latency += DRAM_ACCESS_PENALTY;
+            latency += link_transfer(dram_link, sector_bytes(l2_cache, needed & ~present), now,
+                                     &stats->queue_cycles_dram, &stats->busy_cycles_dram);
+        }
+        l2_cache.sets[l2_index].stats.accesses++;
 
-                l1_cache[l1_index].blocks[l1_lru][0] = addr;
-                l1_cache[l1_index].blocks[l1_lru][1] = l1_tag;
-                l1_cache[l1_index].blocks[l1_lru][2] = true;
-                l1_cache[l1_index].blocks[l1_lru][3] = false;
+        stats->bytes_read_l2 += (uint64_t) 1 << l1_cache.sector_bits;
+        latency += link_transfer(l2_link, (uint64_t) 1 << l1_cache.sector_bits, now,
+                                 &stats->queue_cycles_l2, &stats->busy_cycles_l2);
+    }
+    else {
+        stats->bytes_read_dram += (uint64_t) 1 << l1_cache.sector_bits;
+        latency += DRAM_ACCESS_PENALTY;
+        latency += link_transfer(dram_link, (uint64_t) 1 << l1_cache.sector_bits, now,
+                                 &stats->queue_cycles_dram, &stats->busy_cycles_dram);
+    }
+    latency_record(latency + stats->stall_cycles_write_buffer - stalled, 1, stats);
 
-                popoff_stack(l1_cache[l1_index].lru_stack, l1_lru_tag);
-                set_mru(l1_cache[l1_index].lru_stack, l1_tag);
-            }
-            else {
-                /* open spot in hit block's l1 set, bring in block */
-                l1_cache[l1_index].blocks[open_block][0] = addr;
-                l1_cache[l1_index].blocks[open_block][1] = l1_tag;
-                l1_cache[l1_index].blocks[open_block][2] = true;
-                l1_cache[l1_index].blocks[open_block][3] = false;
+    /* increment l2 read miss if no hit & read operation */
+    if (!l2_hit && rw == READ) {
+        stats->read_misses_l2++;
+    }
+}
 
-                set_mru(l1_cache[l1_index].lru_stack, l1_tag);
+/* subroutine that simulates the cache one trace event at a time */
+void sim_access(char rw, uint64_t addr, sim_stats_t* stats) {
+    /* get tag (the block address) and the sector within the block */
+    uint64_t tag = addr >> l1_cache.block_bits;
+    uint64_t sector = sector_mask(l1_cache, addr, 0);
 
-                return;
-            }            
+    /* increment l1 accesses */
+    stats->accesses_l1++;
 
-            /* now save l1 victim to victim cache - if enabled and there is a victim */
-            uint64_t vi_evicted_addr;
-            if (!vi_disabled) {
-                /* check for open blocks in victim cache */
-                int open_block = available(vi_cache[0].blocks);
+    /* translate the address first - a miss in the tlbs holds up the whole access */
+    if (!dtlb_disabled) {
+        translation_time = tlb_translate(addr, stats->accesses_l1, stats);
+    }
 
-                if (open_block < 0) {
-                    /* no open blocks, need to evict victim lru */
-                    uint64_t vi_lru_tag = get_lru(vi_cache[0].lru_stack);
+    /* search l1 cache for tag - unless the last access left it behind */
+    uint64_t l1_index;
+    int hit_block;
+    if (tag == last_l1.tag) {
+        l1_index = last_l1.index;
+        hit_block = last_l1.way;
+    }
+    else {
+        hit_block = cache_find(l1_cache, tag, &l1_index);
+    }
 
-                    /* get index of victim lru block */
-                    int vi_lru;
-                    for (vi_lru = 0; vi_lru < vi_num_ways; vi_lru++) {
-                        if (vi_cache[0].blocks[vi_lru][1] == vi_lru_tag) break;
-                    }
+    /* l1 cache hit */
+    if (hit_block >= 0 && (l1_cache.sets[l1_index].blocks[hit_block].valid & sector)) {
+        block& hit = l1_cache.sets[l1_index].blocks[hit_block];
+        last_l1.tag = tag;
+        last_l1.index = l1_index;
+        last_l1.way = hit_block;
 
-                    /* save evicted victim lru to temp block */
-                    vi_evicted_addr = vi_cache[0].blocks[vi_lru][0];
+        /* increment hits */
+        stats->hits_l1++;
+        l1_cache.sets[l1_index].stats.accesses++;
 
-                    /* update victim cache block with evicted l1 block info */
-                    vi_cache[0].blocks[vi_lru][0] = l1_evicted_addr;
-                    vi_cache[0].blocks[vi_lru][1] = (l1_evicted_addr >> num_offset_bits) & ((1 << vi_num_tag_bits) - 1);
-                    vi_cache[0].blocks[vi_lru][3] = l1_evicted_dirty;
-                    vi_cache[0].blocks[vi_lru][2] = true;
+        /* determine if read or write */
+        if (rw == WRITE) {
+            /* set dirty bit */
+            hit.dirty |= sector;
 
-                    // if (vi_cache[0].blocks[vi_lru][1] == 35234205) std::cout << "FLAG 424" << std::endl;
+            /* increment writes */
+            stats->writes++;
+        }
+        else {
+            /* increment reads */
+            stats->reads++;
+        }
 
-                    /* remove victim cache lru from lru stack */
-                    popoff_stack(vi_cache[0].lru_stack, vi_lru_tag);
+        /* set hit block to MRU */
+        hit.next_use = next_use;
+        cache_touch(l1_cache, l1_index, hit_block);
+        if (way_predict(l1_cache, tag, l1_index, hit_block)) {
+            stats->way_predicted_hits_l1++;
+            latency_record(l1_first_probe_time, 1, stats);
+        }
+        else {
+            latency_record(l1_lookup_time, 1, stats);
+        }
 
-                    /* set l1 victim tag, now in victim cache, to mru */
-                    set_mru(vi_cache[0].lru_stack, vi_cache[0].blocks[vi_lru][1]);
-                }
-                else {
-                    /* open spot in victim cache, bring in l1 victim */
-                    vi_cache[0].blocks[open_block][0] = l1_evicted_addr;
-                    vi_cache[0].blocks[open_block][1] = (l1_evicted_addr >> num_offset_bits) & ((1 << vi_num_tag_bits) - 1);;
-                    vi_cache[0].blocks[open_block][2] = true;
-                    vi_cache[0].blocks[open_block][3] = l1_evicted_dirty;
+        return;
+    }
 
-                    /* set newly filled block to mru */
-                    // if (vi_cache[0].blocks[open_block][1] == 35234205) std::cout << "FLAG 440" << std::endl;
-                    set_mru(vi_cache[0].lru_stack, vi_cache[0].blocks[open_block][1]);
+    /* function did not return, increment l1 misses */
+    stats->misses_l1++;
 
-                    return;
-                }
-            }
+    /* a sector miss leaves the block where it is and only fetches the sector; otherwise the block
+     * ends up in l1 whatever happens below - find the open block or lru it replaces */
+    bool resident = hit_block >= 0;
+    int l1_victim = resident ? hit_block : cache_victim(l1_cache, tag, &l1_index);
+    last_l1.tag = tag;
+    last_l1.index = l1_index;
+    last_l1.way = l1_victim;
+    way_predict(l1_cache, tag, l1_index, l1_victim);
+    l1_cache.sets[l1_index].stats.accesses++;
+    l1_cache.sets[l1_index].stats.misses++;
+
+    /* check if victim cache is enabled - it can only hold blocks that are not in l1 */
+    if (!resident && !vi_disabled) {
+        /* search victim cache for tag */
+        uint64_t vi_index;
+        hit_block = cache_find(vi_cache, tag, &vi_index);
 
-            /* save either l1 lru or victim lru to l2 */
-            uint64_t victim_index;
-            if (vi_evicted_addr == 0) {
-                /* current incoming block is from l1 */
-                victim_index = (l1_evicted_addr >> num_offset_bits) & ((1 << l2_num_index_bits) - 1);
+        /* victim cache hit */
+        if (hit_block >= 0) {
+            block hit = vi_cache.sets[0].blocks[hit_block];
+            block& l1_lru = l1_cache.sets[l1_index].blocks[l1_victim];
+            stats->bytes_victim_cache_to_l1 += sector_bytes(l1_cache, hit.valid);
+            if (l1_lru.valid) {
+                /* no open spots in l1 set - swap, the l1 lru becomes the victim mru */
+                cache_evicted(l1_cache, l1_index, l1_lru);
+                stats->bytes_l1_to_victim_cache += sector_bytes(l1_cache, l1_lru.valid);
+                cache_fill(vi_cache, 0, hit_block, l1_lru.tag, l1_lru.valid, l1_lru.dirty, l1_lru.next_use);
             }
             else {
-                /* current incoming block is from the victim cache */
-                victim_index = (vi_evicted_addr >> num_offset_bits) & ((1 << l2_num_index_bits) - 1);
+                /* open spot available, remove hit block from victim cache */
+                vi_cache.sets[0].blocks[hit_block].valid = 0;
             }
-            
-            /* check for open blocks in l2 cache */
-            open_block = available(l2_cache[victim_index].blocks);
-
-            if (open_block < 0) {
-                /* no open blocks, need to evict l2 block */
-                uint64_t l2_lru_tag = get_lru(l2_cache[victim_index].lru_stack);
-
-                /* get index of victim lru block */
-                int l2_lru;
-                for (l2_lru = 0; l2_lru < l2_num_ways; l2_lru++) {
-                    if (l2_cache[0].blocks[l2_lru][1] == l2_lru_tag) break;
-                }
 
-                /* update l2 cache block with evicted l1/victim block info */
-                if (vi_evicted_addr == 0) {
-                    l2_cache[victim_index].blocks[l2_lru][0] = l1_evicted_addr;
-                    l2_cache[victim_index].blocks[l2_lru][1] = (l1_evicted_addr >> (l2_num_index_bits + num_offset_bits)) & ((1 << l2_num_tag_bits) - 1);
-                    l2_cache[victim_index].blocks[l2_lru][3] = false;
-                    l2_cache[victim_index].blocks[l2_lru][2] = true;
-                }
-                else {
-                    l2_cache[victim_index].blocks[l2_lru][0] = vi_evicted_addr;
-                    l2_cache[victim_index].blocks[l2_lru][1] = (vi_evicted_addr >> (l2_num_index_bits + num_offset_bits)) & ((1 << l2_num_tag_bits) - 1);
-                    l2_cache[victim_index].blocks[l2_lru][3] = false;
-                    l2_cache[victim_index].blocks[l2_lru][2] = true;
-                }
+            /* save hit block in l1 as its mru */
+            cache_fill(l1_cache, l1_index, l1_victim, tag, hit.valid, hit.dirty, next_use);
 
-                /* increment write backs as victim block is no longer dirty in l2 */
-                stats->write_backs_l1_or_victim_cache++;
+            if (hit.valid & sector) {
+                /* increment hits */
+                stats->hits_victim_cache++;
 
-                /* remove l2 cache lru from lru stack */
-                popoff_stack(l2_cache[victim_index].lru_stack, l2_lru_tag);
+                /* determine if read or write */
+                if (rw == WRITE) {
+                    /* set dirty bit */
+                    l1_cache.sets[l1_index].blocks[l1_victim].dirty |= sector;
 
-                /* set l1/victim lru tag, now in l2 cache, to mru OR lru depending on insertion policy */
-                if (l2_insert_policy == INSERT_POLICY_MIP) {
-                    set_mru(l2_cache[victim_index].lru_stack, l2_cache[victim_index].blocks[l2_lru][1]);
-                }
-                else {
-                    set_lru(l2_cache[victim_index].lru_stack, l2_cache[victim_index].blocks[l2_lru][1]);
-                }
-            }
-            else {
-                /* open spot in l2 cache, bring in l1/victim lru */
-                if (vi_evicted_addr == 0) {
-                    l2_cache[victim_index].blocks[open_block][0] = l1_evicted_addr;
-                    l2_cache[victim_index].blocks[open_block][1] = (l1_evicted_addr >> (l2_num_index_bits + num_offset_bits)) & ((1 << l2_num_tag_bits) - 1);
-                    l2_cache[victim_index].blocks[open_block][3] = false;
-                    l2_cache[victim_index].blocks[open_block][2] = true;
+                    /* increment writes */
+                    stats->writes++;
                 }
                 else {
-                    l2_cache[victim_index].blocks[open_block][0] = vi_evicted_addr;
-                    l2_cache[victim_index].blocks[open_block][1] = (vi_evicted_addr >> (l2_num_index_bits + num_offset_bits)) & ((1 << l2_num_tag_bits) - 1);
-                    l2_cache[victim_index].blocks[open_block][3] = false;
-                    l2_cache[victim_index].blocks[open_block][2] = true;
-                }
-
-                /* increment write backs as victim block is no longer dirty in l2 */
-                stats->write_backs_l1_or_victim_cache++;
-
-                /* set newly filled block to mru OR lru depending on insertion policy */
-                if (l2_insert_policy == INSERT_POLICY_MIP) {
-                    set_mru(l2_cache[victim_index].lru_stack, l2_cache[victim_index].blocks[open_block][1]);
-                }
-                else {
-                    set_lru(l2_cache[victim_index].lru_stack, l2_cache[victim_index].blocks[open_block][1]);
+                    /* increment reads */
+                    stats->reads++;
                 }
 
+                /* the victim cache is searched alongside l1 */
+                latency_record(l1_lookup_time, 1, stats);
                 return;
             }
 
-            /* if an l2 block is evicted, it would be saved to DRAM here */
-            return;
+            /* the block is back in l1 but the sector still has to be fetched */
+            resident = true;
         }
     }
 
-    /* increment l2 read miss if no hit & read operation */
-    if (rw == READ) {
-        stats->read_misses_l2++;
+    /* victim cache disabled or function did not return, increment victim misses */
+    stats->misses_victim_cache++;
+
+    /* fetch the sector from l2 or memory */
+    if (l2_hook) {
+        l2_event_t event = {L2_EVENT_MISS, rw, addr, stats->accesses_l1, 0, 0};
+        l2_hook(&event, l2_hook_arg);
+    }
+    else {
+        l2_access(rw, addr, stats->accesses_l1, stats);
+    }
+
+    /* sector fill into a block already in l1 - nothing is evicted */
+    if (resident) {
+        l1_cache.sets[l1_index].blocks[l1_victim].valid |= sector;
+        l1_cache.sets[l1_index].blocks[l1_victim].next_use = next_use;
+        cache_touch(l1_cache, l1_index, l1_victim);
+        return;
     }
 
-    /* TOTAL CACHE MISS - now bring block in from memory, and cascade down with any victim blocks */
+    /* bring block in from l2 or memory, and cascade down with any victim blocks */
+    block evicted = l1_cache.sets[l1_index].blocks[l1_victim];
+    cache_fill(l1_cache, l1_index, l1_victim, tag, sector, 0, next_use);
 
-    /* see if there are any spots in l1 */
-    int open_block = available(l1_cache[l1_index].blocks);
-    uint64_t l1_evicted_addr;
-    bool l1_evicted_dirty;
-    if (open_block < 0) {
-        /* no spots available, get l1 lru tag */
-        uint64_t l1_lru_tag = get_lru(l1_cache[l1_index].lru_stack);
+    /* open spot in l1, nothing to cascade */
+    if (!evicted.valid) {
+        return;
+    }
+    cache_evicted(l1_cache, l1_index, evicted);
 
-        /* get index of l1 lru in blocks */
-        int l1_lru;
-        for (l1_lru = 0; l1_lru < l1_num_ways; l1_lru++) {
-            if (l1_cache[l1_index].blocks[l1_lru][1] == l1_lru_tag) break;
+    /* save l1 victim to victim cache - if enabled */
+    if (!vi_disabled) {
+        uint64_t vi_index;
+        int vi_victim = cache_victim(vi_cache, evicted.tag, &vi_index);
+        block vi_evicted = vi_cache.sets[0].blocks[vi_victim];
+        cache_fill(vi_cache, 0, vi_victim, evicted.tag, evicted.valid, evicted.dirty, evicted.next_use);
+        stats->bytes_l1_to_victim_cache += sector_bytes(l1_cache, evicted.valid);
+
+        /* open spot in victim cache, nothing falls out of it */
+        if (!vi_evicted.valid) {
+            return;
         }
+        evicted = vi_evicted;
+    }
 
-        /* bring in DRAM hit, evict l1 lru to victim (if enabled) */
-        l1_evicted_addr = l1_cache[l1_index].blocks[l1_lru][0];
-        l1_evicted_dirty = l1_cache[l1_index].blocks[l1_lru][3];
+    /* finally - save evicted block to l2 if enabled; otherwise block just goes back to DRAM */
+    if (l2_hook) {
+        l2_event_t event = {L2_EVENT_EVICT, 0, evicted.tag, stats->accesses_l1, evicted.valid, evicted.dirty};
+        l2_hook(&event, l2_hook_arg);
+    }
+    else {
+        l2_insert(evicted, stats->accesses_l1, stats);
+    }
+}
 
-        l1_cache[l1_index].blocks[l1_lru][0] = addr;
-        l1_cache[l1_index].blocks[l1_lru][1] = l1_tag;
-        l1_cache[l1_index].blocks[l1_lru][2] = true;
-        l1_cache[l1_index].blocks[l1_lru][3] = false;
+/* only the first access can miss - it leaves the block in l1 with the sector valid, so the rest are
+ * hits on it, counted all at once. the block is stamped as if touched once per access */
+void sim_access_run(char rw, uint64_t addr, uint64_t count, sim_stats_t* stats) {
+    sim_access(rw, addr, stats);
+    uint64_t repeats = count - 1;
+    if (!repeats) {
+        return;
+    }
 
-        popoff_stack(l1_cache[l1_index].lru_stack, l1_lru_tag);
-        set_mru(l1_cache[l1_index].lru_stack, l1_tag);
+    /* the rest hit the dtlb entry the first one left behind */
+    if (!dtlb_disabled) {
+        uint64_t index;
+        int way = cache_find(dtlb_cache, addr >> page_bits, &index);
+        stats->accesses_dtlb += repeats;
+        dtlb_cache.clock += repeats - 1;
+        cache_touch(dtlb_cache, index, way);
+        translation_time = 0;
+    }
+
+    stats->accesses_l1 += repeats;
+    stats->hits_l1 += repeats;
+    l1_cache.sets[last_l1.index].stats.accesses += repeats;
+    if (rw == WRITE) {
+        l1_cache.sets[last_l1.index].blocks[last_l1.way].dirty |= sector_mask(l1_cache, addr, 0);
+        stats->writes += repeats;
     }
     else {
-        /* save block from memory into open block */
-        l1_cache[l1_index].blocks[open_block][1] = l1_tag;
-        l1_cache[l1_index].blocks[open_block][0] = addr;
-        l1_cache[l1_index].blocks[open_block][2] = true;
-        l1_cache[l1_index].blocks[open_block][3] = false;
+        stats->reads += repeats;
+    }
 
-        /* set incoming block as the mru */
-        set_mru(l1_cache[l1_index].lru_stack, l1_tag);
+    l1_cache.clock += repeats - 1;
+    cache_touch(l1_cache, last_l1.index, last_l1.way);
+    if (l1_cache.way_prediction) {
+        stats->way_predicted_hits_l1 += repeats;
+    }
+    latency_record(l1_first_probe_time, repeats, stats);
+}
 
-        return;
+void sim_access_opt(char rw, uint64_t addr, uint64_t next, sim_stats_t* stats) {
+    next_use = next;
+    sim_access(rw, addr, stats);
+    next_use = NO_NEXT_USE;
+}
+
+void sim_set_l2_hook(l2_hook_t hook, void *arg) {
+    l2_hook = hook;
+    l2_hook_arg = arg;
+}
+
+/* feeds one recorded l1-side request to l2 as sim_access would have */
+void sim_replay(const l2_event_t *event, sim_stats_t *stats) {
+    if (event->type == L2_EVENT_MISS) {
+        l2_access(event->rw, event->addr, event->access, stats);
     }
+    else {
+        block evicted = {event->addr, 0, event->valid, event->dirty, NO_NEXT_USE};
+        l2_insert(evicted, event->access, stats);
+    }
+}
 
-    /* now check victim cache for open spots - if there was an eviction in previous stage */
-    uint64_t vi_evicted_addr;
-    if (!vi_disabled) {
-        /* check for open blocks in victim cache */
-        int open_block = available(vi_cache[0].blocks);
-
-        if (open_block < 0) {
-            /* no open blocks, need to evict victim lru */
-            uint64_t vi_lru_tag = get_lru(vi_cache[0].lru_stack);
-            // std::cout << "vi_lru_tag: " << vi_lru_tag << std::endl;
-
-            // std::cout << "vi lru stack: " << std::endl;
-            // for (int i = 0; i < vi_num_ways; i++) {
-            //     std::cout << vi_cache[0].lru_stack[i] << std::endl;
-            // }
-
-            /* get index of victim lru block */
-            int vi_lru;
-            // std::cout << "vi blocks: " << std::endl;
-            // for (int i = 0; i < vi_num_ways; i++) {
-            //     if (vi_cache[0].blocks[i][2] == true) std::cout << vi_cache[0].blocks[i][1] << std::endl;
-            // }
-            for (vi_lru = 0; vi_lru < vi_num_ways; vi_lru++) {
-                // std::cout << vi_cache[0].blocks[vi_lru][1] << std::endl;
-                if (vi_cache[0].blocks[vi_lru][1] == vi_lru_tag) break;
-            }
+static void collect_set_stats(cache& c) {
+    c.set_stats.resize(c.sets.size());
+    for (size_t i = 0; i < c.sets.size(); i++) {
+        c.set_stats[i] = c.sets[i].stats;
+    }
+}
 
-            /* save evicted victim lru to temp block */
-            vi_evicted_addr = vi_cache[0].blocks[vi_lru][0];
+/* subroutine for calculating overall statistics such as miss rate or average access time */
+void sim_finish(sim_stats_t *stats) {
+    /* whatever is left in the write buffer drains at the end of the trace */
+    while (!write_buffer.empty()) {
+        write_buffer_drain(0, &stats->flush_drains_write_buffer, stats);
+    }
 
-            /* update victim cache block with evicted l1 block info */
-            vi_cache[0].blocks[vi_lru][0] = l1_evicted_addr;
-            vi_cache[0].blocks[vi_lru][1] = (l1_evicted_addr >> num_offset_bits) & ((1 << vi_num_tag_bits) - 1);
-            vi_cache[0].blocks[vi_lru][3] = l1_evicted_dirty;
-            vi_cache[0].blocks[vi_lru][2] = true;
+    /* per-set counters */
+    collect_set_stats(l1_cache);
+    stats->num_sets_l1 = l1_cache.set_stats.size();
+    stats->set_stats_l1 = l1_cache.set_stats.data();
 
-            /* remove victim cache lru from lru stack */
-            // if (vi_lru_tag == 35234205) std::cout << "FLAG 617" << std::endl;
-            popoff_stack(vi_cache[0].lru_stack, vi_lru_tag);
+    collect_set_stats(l2_cache);
+    stats->num_sets_l2 = l2_cache.set_stats.size();
+    stats->set_stats_l2 = l2_cache.set_stats.data();
 
-            /* set l1 victim tag, now in victim cache, to mru */
-            set_mru(vi_cache[0].lru_stack, vi_cache[0].blocks[vi_lru][1]);
-        }
-        else {
-            /* open spot in victim cache, bring in l1 victim */
-            vi_cache[0].blocks[open_block][0] = l1_evicted_addr;
-            vi_cache[0].blocks[open_block][1] = (l1_evicted_addr >> num_offset_bits) & ((1 << vi_num_tag_bits) - 1);;
-            vi_cache[0].blocks[open_block][2] = true;
-            vi_cache[0].blocks[open_block][3] = l1_evicted_dirty;
+    /* calculate stats */
+    sim_compute_ratios(&sim_config, stats);
+}
 
-            /* set newly filled block to mru */
-            // if (vi_cache[0].blocks[open_block][1] == 35234205) std::cout << "FLAG 631" << std::endl;
-            set_mru(vi_cache[0].lru_stack, vi_cache[0].blocks[open_block][1]);
+static double ratio(uint64_t part, uint64_t whole) {
+    return whole ? (double) part / whole : 0;
+}
 
-            return;
-        }
+/* the victim cache is searched on every l1 miss, and the l2 on every victim cache miss - only
+ * reads are on the critical path, so the l2 ratios and access time count reads */
+void sim_compute_ratios(const sim_config_t *config, sim_stats_t *stats) {
+    stats->hit_ratio_l1 = ratio(stats->hits_l1, stats->accesses_l1);
+    stats->miss_ratio_l1 = ratio(stats->misses_l1, stats->accesses_l1);
+
+    stats->hit_ratio_victim_cache = ratio(stats->hits_victim_cache, stats->misses_l1);
+    stats->miss_ratio_victim_cache = ratio(stats->misses_victim_cache, stats->misses_l1);
+
+    stats->read_hit_ratio_l2 = ratio(stats->read_hits_l2, stats->reads_l2);
+    stats->read_miss_ratio_l2 = ratio(stats->read_misses_l2, stats->reads_l2);
+
+    /* with way prediction, a predicted hit only takes the first probe and everything else takes both */
+    stats->way_prediction_accuracy_l1 = ratio(stats->way_predicted_hits_l1, stats->hits_l1);
+    stats->way_prediction_accuracy_l2 = ratio(stats->way_predicted_read_hits_l2, stats->read_hits_l2);
+    double hit_time_l1 = L1_HIT_TIME_CONST + L1_HIT_TIME_PER_S * config->l1_config.s;
+    double hit_time_l2 = L2_HIT_TIME_CONST + L2_HIT_TIME_PER_S * config->l2_config.s;
+    if (config->l1_config.way_prediction) {
+        hit_time_l1 = L1_HIT_TIME_CONST
+            + (1 - ratio(stats->way_predicted_hits_l1, stats->accesses_l1)) * hit_time_l1;
+    }
+    if (config->l2_config.way_prediction) {
+        hit_time_l2 = L2_HIT_TIME_CONST
+            + (1 - ratio(stats->way_predicted_read_hits_l2, stats->reads_l2)) * hit_time_l2;
     }
 
-    /* finally - save evicted block to l2 if needed and enabled; otherwise block just goes back to DRAM */
-    uint64_t victim_index;
-    if (vi_evicted_addr == 0) {
-        /* current incoming block is from l1 */
-        victim_index = (l1_evicted_addr >> num_offset_bits) & ((1 << l2_num_index_bits) - 1);
+    /* without an l2 every miss goes to DRAM */
+    if (config->l2_config.disabled) {
+        stats->avg_access_time_l2 = DRAM_ACCESS_PENALTY;
     }
     else {
-        /* current incoming block is from the victim cache */
-        victim_index = (vi_evicted_addr >> num_offset_bits) & ((1 << l2_num_index_bits) - 1);
-    }
-    
-    /* check for open blocks in l2 cache */
-    open_block = available(l2_cache[victim_index].blocks);
-
-    if (open_block < 0) {
-        /* no open blocks, need to evict l2 block */
-        uint64_t l2_lru_tag = get_lru(l2_cache[victim_index].lru_stack);
-
-        /* get index of victim lru block */
-        int l2_lru;
-        for (l2_lru = 0; l2_lru < l2_num_ways; l2_lru++) {
-            if (l2_cache[victim_index].blocks[l2_lru][1] == l2_lru_tag) break;
-        }
-
-        if (l2_lru == l2_num_ways) {
-            std::cout << "FUCK " << addr << std::endl;
-            for (int i = 0; i < l2_num_ways; i++) {
-                bool match = false;
-                for (int g = 0; g < l2_num_ways; g++) {
-                    if (l2_cache[victim_index].blocks[i][1] == l2_cache[victim_index].lru_stack[g] && l2_cache[victim_index].blocks[i][2]) {
-                        match = true;
-                    }
-                }
-                if (!match) {
-                    std::cout << "FUCK PT 2 " << addr << std::endl;
-                }
-            }
-        }
+        stats->avg_access_time_l2 = hit_time_l2 + stats->read_miss_ratio_l2 * DRAM_ACCESS_PENALTY;
+    }
+    stats->avg_access_time_l1 = hit_time_l1
+        + stats->miss_ratio_l1 * stats->miss_ratio_victim_cache * stats->avg_access_time_l2;
+
+    /* translation is charged to every access */
+    stats->miss_ratio_dtlb = ratio(stats->misses_dtlb, stats->accesses_dtlb);
+    stats->miss_ratio_stlb = ratio(stats->misses_stlb, stats->misses_dtlb);
+    if (!config->dtlb_config.disabled) {
+        stats->avg_translation_time = stats->accesses_l1 ? stats->translation_cycles / stats->accesses_l1 : 0;
+        stats->avg_access_time_l1 += stats->avg_translation_time;
+    }
+}
 
-        /* update l2 cache block with evicted l1/victim block info */
-        if (vi_evicted_addr == 0) {
-            l2_cache[victim_index].blocks[l2_lru][0] = l1_evicted_addr;
-            l2_cache[victim_index].blocks[l2_lru][1] = (l1_evicted_addr >> (l2_num_index_bits + num_offset_bits)) & ((1 << l2_num_tag_bits) - 1);
-            l2_cache[victim_index].blocks[l2_lru][3] = false;
-            l2_cache[victim_index].blocks[l2_lru][2] = true;
-        }
-        else {
-            l2_cache[victim_index].blocks[l2_lru][0] = vi_evicted_addr;
-            l2_cache[victim_index].blocks[l2_lru][1] = (vi_evicted_addr >> (l2_num_index_bits + num_offset_bits)) & ((1 << l2_num_tag_bits) - 1);
-            l2_cache[victim_index].blocks[l2_lru][3] = false;
-            l2_cache[victim_index].blocks[l2_lru][2] = true;
+double sim_latency_percentile(const sim_stats_t *stats, double p) {
+    uint64_t count = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        count += stats->latency_histogram[i];
+    }
+    if (!count) {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t) ceil(p * count);
+    rank = rank ? rank : 1;
+    uint64_t seen = 0;
+    int i = 0;
+    for (; i < LATENCY_BUCKETS - 1; i++) {
+        seen += stats->latency_histogram[i];
+        if (seen >= rank) {
+            break;
         }
+    }
 
-        /* increment write backs as victim block is no longer dirty in l2 */
-        stats->write_backs_l1_or_victim_cache++;
+    /* the top of the bucket, but never past the slowest access */
+    uint64_t value = latency_bucket_max(i);
+    value = value < stats->latency_max ? value : stats->latency_max;
+    return value / LATENCY_UNITS_PER_CYCLE;
+}
 
-        /* remove l2 cache lru from lru stack */
-        popoff_stack(l2_cache[victim_index].lru_stack, l2_lru_tag);
+/* accesses only interact through the sets they map to, so address bits that are part of both
+ * the l1 and l2 set index split the trace into independent shards. the victim cache, the
+ * write buffer, bandwidth-limited links and the tlbs are shared by every set and hashed index functions
+ * mix in tag bits, so those configurations cannot be split */
+uint64_t sim_shard_bits(const sim_config_t *config, uint64_t *shift) {
+    const cache_config_t *l1 = &config->l1_config;
+    const cache_config_t *l2 = &config->l2_config;
+
+    if (config->victim_cache_entries || l1->index_func != INDEX_FUNC_MODULO
+        || config->l2_bandwidth || config->dram_bandwidth || !config->dtlb_config.disabled) {
+        return 0;
+    }
 
-        /* set l1/victim lru tag, now in l2 cache, to mru OR lru depending on insertion policy */
-        if (l2_insert_policy == INSERT_POLICY_MIP) {
-            set_mru(l2_cache[victim_index].lru_stack, l2_cache[victim_index].blocks[l2_lru][1]);
+    uint64_t low = l1->b;
+    uint64_t high = l1->c - l1->s;
+    if (!l2->disabled) {
+        if (l2->index_func != INDEX_FUNC_MODULO
+            || (config->write_buffer_entries && l2->write_strat == WRITE_STRAT_WTWNA)) {
+            return 0;
         }
-        else {
-            set_lru(l2_cache[victim_index].lru_stack, l2_cache[victim_index].blocks[l2_lru][1]);
+        low = l2->b > low ? l2->b : low;
+        high = l2->c - l2->s < high ? l2->c - l2->s : high;
+    }
+
+    *shift = low;
+    return high > low ? high - low : 0;
+}
+
+/* adds the counters of one shard into total. ratios and the per-set arrays are left alone */
+void sim_merge_stats(sim_stats_t *total, const sim_stats_t *shard) {
+    total->reads += shard->reads;
+    total->writes += shard->writes;
+    total->accesses_l1 += shard->accesses_l1;
+    total->reads_l2 += shard->reads_l2;
+    total->writes_l2 += shard->writes_l2;
+    total->write_backs_l1_or_victim_cache += shard->write_backs_l1_or_victim_cache;
+    total->hits_l1 += shard->hits_l1;
+    total->hits_victim_cache += shard->hits_victim_cache;
+    total->read_hits_l2 += shard->read_hits_l2;
+    total->misses_l1 += shard->misses_l1;
+    total->misses_victim_cache += shard->misses_victim_cache;
+    total->read_misses_l2 += shard->read_misses_l2;
+
+    total->writes_absorbed_write_buffer += shard->writes_absorbed_write_buffer;
+    total->drains_write_buffer += shard->drains_write_buffer;
+    total->capacity_drains_write_buffer += shard->capacity_drains_write_buffer;
+    total->timeout_drains_write_buffer += shard->timeout_drains_write_buffer;
+    total->conflict_drains_write_buffer += shard->conflict_drains_write_buffer;
+    total->flush_drains_write_buffer += shard->flush_drains_write_buffer;
+    total->stall_cycles_write_buffer += shard->stall_cycles_write_buffer;
+
+    total->bytes_read_l2 += shard->bytes_read_l2;
+    total->bytes_written_l2 += shard->bytes_written_l2;
+    total->bytes_read_dram += shard->bytes_read_dram;
+    total->bytes_written_dram += shard->bytes_written_dram;
+    total->bytes_l1_to_victim_cache += shard->bytes_l1_to_victim_cache;
+    total->bytes_victim_cache_to_l1 += shard->bytes_victim_cache_to_l1;
+    total->queue_cycles_l2 += shard->queue_cycles_l2;
+    total->queue_cycles_dram += shard->queue_cycles_dram;
+    total->busy_cycles_l2 += shard->busy_cycles_l2;
+    total->busy_cycles_dram += shard->busy_cycles_dram;
+
+    total->latency_total += shard->latency_total;
+    total->latency_max = shard->latency_max > total->latency_max ? shard->latency_max : total->latency_max;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        total->latency_histogram[i] += shard->latency_histogram[i];
+    }
+
+    total->accesses_dtlb += shard->accesses_dtlb;
+    total->misses_dtlb += shard->misses_dtlb;
+    total->misses_stlb += shard->misses_stlb;
+    total->page_walks += shard->page_walks;
+    total->walk_references += shard->walk_references;
+    total->walk_references_dram += shard->walk_references_dram;
+    total->translation_cycles += shard->translation_cycles;
+
+    total->way_predicted_hits_l1 += shard->way_predicted_hits_l1;
+    total->way_predicted_read_hits_l2 += shard->way_predicted_read_hits_l2;
+}
+
+/* adds the counters of a set from one shard into total, keeping the most evicted blocks of both */
+void sim_merge_set_stats(set_stats_t *total, const set_stats_t *shard) {
+    total->accesses += shard->accesses;
+    total->misses += shard->misses;
+    total->evictions += shard->evictions;
+
+    block_count_t blocks[2 * SET_STATS_TOP_BLOCKS];
+    int num_blocks = 0;
+    for (int i = 0; i < SET_STATS_TOP_BLOCKS; i++) {
+        if (total->top_blocks[i].count) {
+            blocks[num_blocks++] = total->top_blocks[i];
         }
     }
-    else {
-        /* open spot in l2 cache, bring in l1/victim lru */
-        if (vi_evicted_addr == 0) {
-            l2_cache[victim_index].blocks[open_block][0] = l1_evicted_addr;
-            l2_cache[victim_index].blocks[open_block][1] = (l1_evicted_addr >> (l2_num_index_bits + num_offset_bits)) & ((1 << l2_num_tag_bits) - 1);
-            l2_cache[victim_index].blocks[open_block][3] = false;
-            l2_cache[victim_index].blocks[open_block][2] = true;
+    for (int i = 0; i < SET_STATS_TOP_BLOCKS; i++) {
+        if (!shard->top_blocks[i].count) {
+            continue;
+        }
+        int j = 0;
+        while (j < num_blocks && blocks[j].addr != shard->top_blocks[i].addr) {
+            j++;
+        }
+        if (j == num_blocks) {
+            blocks[num_blocks++] = shard->top_blocks[i];
         }
         else {
-            l2_cache[victim_index].blocks[open_block][0] = vi_evicted_addr;
-            l2_cache[victim_index].blocks[open_block][1] = (vi_evicted_addr >> (l2_num_index_bits + num_offset_bits)) & ((1 << l2_num_tag_bits) - 1);
-            l2_cache[victim_index].blocks[open_block][3] = false;
-            l2_cache[victim_index].blocks[open_block][2] = true;
+            blocks[j].count += shard->top_blocks[i].count;
         }
+    }
 
-        /* increment write backs as victim block is no longer dirty in l2 */
-        stats->write_backs_l1_or_victim_cache++;
-
-        /* set newly filled block to mru OR lru depending on insertion policy */
-        if (l2_insert_policy == INSERT_POLICY_MIP) {
-            set_mru(l2_cache[victim_index].lru_stack, l2_cache[victim_index].blocks[open_block][1]);
+    /* keep the largest counts */
+    for (int i = 0; i < SET_STATS_TOP_BLOCKS; i++) {
+        int max = i;
+        for (int j = i + 1; j < num_blocks; j++) {
+            if (blocks[j].count > blocks[max].count) {
+                max = j;
+            }
+        }
+        if (i < num_blocks) {
+            block_count_t tmp = blocks[i];
+            blocks[i] = blocks[max];
+            blocks[max] = tmp;
+            total->top_blocks[i] = blocks[i];
         }
         else {
-            set_lru(l2_cache[victim_index].lru_stack, l2_cache[victim_index].blocks[open_block][1]);
+            total->top_blocks[i].addr = 0;
+            total->top_blocks[i].count = 0;
         }
-
-        return;
     }
 }
-
-/* subroutine for calculating overall statistics such as miss rate or average access time */
-void sim_finish(sim_stats_t *stats) {
-    /* calculate stats */
-    // stats->avg_access_time_l1 = ;
-    // stats->hit_ratio_l1 = stats->hits_l1 / stats->accesses_l1;
-    // stats->miss_ratio_l1 = stats->misses_l1 / stats->accesses_l1;
-
-    // stats->hit_ratio_victim_cache = ;
-    // stats->miss_ratio_victim_cache = ;
-
-    // stats->avg_access_time_l2 = ;
-    // stats->read_hit_ratio_l2 = ;
-    // stats->read_miss_ratio_l2 = ;
-
-    // /* free blocks */
-    // for (int i = 0; i < l1_num_sets; i++) {
-    //     for (int j = 0; j < l1_num_ways; j++) {
-    //         delete l1_cache[i].blocks[j];
-    //     }
-    // }
-
-    // for (int i = 0; i < l2_num_sets; i++) {
-    //     for (int j = 0; j < l2_num_ways; j++) {
-    //         delete l2_cache[i].blocks[j];
-    //     }
-    // }
-
-    // for (int j = 0; j < vi_num_ways; j++) {
-    //     delete vi_cache[0].blocks[j];
-    // }
-}
-
@@ -12,6 +12,10 @@ typedef enum insert_policy {
     // LIP inserts blocks at the LRU position (instead of MRU) as proposed by
     // Qureshi et al. (2007). Please see the PDF for details
     INSERT_POLICY_LIP,
+    // Belady's OPT: evicts the block whose next use is farthest in the future.
+    // Not realizable, it needs the whole trace ahead of time (see
+    // sim_access_opt), but it bounds how well any replacement policy can do
+    INSERT_POLICY_OPT,
 } insert_policy_t;
 
 typedef enum write_strat {
@@ -21,6 +25,22 @@ typedef enum write_strat {
     WRITE_STRAT_WTWNA,
 } write_strat_t;
 
+// How a block address is mapped to a set
+typedef enum index_func {
+    // Conventional indexing: the low index bits of the block address
+    INDEX_FUNC_MODULO,
+    // XOR of every index-sized slice of the block address, so power-of-two
+    // strides that share their low bits still spread across the sets
+    INDEX_FUNC_XOR,
+    // Block address modulo the largest prime that is no more than the number
+    // of sets. The sets above that prime are left unused
+    INDEX_FUNC_PRIME,
+    // Skewed-associative placement as proposed by Seznec (1993): each way is
+    // indexed with a different XOR hash, so blocks that conflict in one way
+    // rarely conflict in the others
+    INDEX_FUNC_SKEW,
+} index_func_t;
+
 typedef struct cache_config {
     bool disabled;
     // (C,B,S) in the Conte Cache Taxonomy (Patent Pending)
@@ -29,14 +49,83 @@ typedef struct cache_config {
     uint64_t s;
     insert_policy_t insert_policy;
     write_strat_t write_strat;
+    index_func_t index_func;
+    // Sectored caches: one tag covers the 2^b byte block, which is fetched
+    // and kept valid or dirty in 2^sector_b byte sectors. 0 means unsectored
+    uint64_t sector_b;
+    // MRU way prediction: a lookup first probes only the way last accessed
+    // in the set, which takes the hit time of a direct-mapped cache
+    // (HIT_TIME_CONST). A hit in another way, or a miss, is only found by a
+    // second probe of every way, which takes the full hit time on top
+    bool way_prediction;
 } cache_config_t;
 
+// A translation lookaside buffer caching 2^e page translations in sets of
+// 2^s entries, with LRU replacement
+typedef struct tlb_config {
+    bool disabled;
+    uint64_t e;
+    uint64_t s;
+} tlb_config_t;
+
 typedef struct sim_config {
     cache_config_t l1_config;
     uint64_t victim_cache_entries;
     cache_config_t l2_config;
+    // Write-combining buffer in front of a write-through L2. 0 entries
+    // disables it. Entries drain after write_buffer_timeout accesses (0 means
+    // never), when the buffer is full, or when an L2 read needs the block
+    uint64_t write_buffer_entries;
+    uint64_t write_buffer_timeout;
+    // Bandwidth-limited queueing. Accesses arrive every access_interval
+    // cycles, and a transfer occupies its link for bytes / bandwidth cycles.
+    // A request that finds its link busy waits for it, and the waiting adds
+    // to its latency. A bandwidth of 0 (bytes per cycle) means unlimited
+    double l2_bandwidth;
+    double dram_bandwidth;
+    double access_interval;
+    // Address translation in front of L1: the DTLB, backed by the STLB when
+    // enabled, and a page walk that reads one page table entry per level
+    // through L2 (or DRAM) on a miss in both. Pages are 2^page_b bytes: 4KB
+    // pages take a four-level walk, 2MB pages three and 1GB pages two.
+    // Caches are still indexed and tagged with the trace addresses
+    tlb_config_t dtlb_config;
+    tlb_config_t stlb_config;
+    uint64_t page_b;
 } sim_config_t;
 
+// A block address (of the first byte) and how often it was evicted
+typedef struct block_count {
+    uint64_t addr;
+    uint64_t count;
+} block_count_t;
+
+// Most evicted blocks kept per set
+static const int SET_STATS_TOP_BLOCKS = 4;
+
+// Per-set counters. For skewed caches a hit is charged to the row it hit in
+// and a miss to the row of the block it would replace. An eviction is a valid
+// block being replaced (an L1 block moving to the victim cache counts).
+// top_blocks approximates the most evicted blocks of the set with the
+// space-saving algorithm: a block that takes over a slot inherits its count,
+// so counts can overestimate by up to the smallest count in the set. A block
+// evicted more than once was fetched back in between, so it is thrashing
+typedef struct set_stats {
+    uint64_t accesses;
+    uint64_t misses;
+    uint64_t evictions;
+    block_count_t top_blocks[SET_STATS_TOP_BLOCKS];
+} set_stats_t;
+
+// Access latencies are kept in hundredths of a cycle and counted in a
+// log-linear histogram, as in HdrHistogram: values below 2^LATENCY_SUB_BITS
+// get a bucket each, and every power of two above that is split into
+// 2^LATENCY_SUB_BITS equal buckets, so a bucket is within 1/32 of the values
+// it holds whatever their magnitude
+static const int LATENCY_SUB_BITS = 5;
+static const int LATENCY_BUCKETS = (64 - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS;
+static const double LATENCY_UNITS_PER_CYCLE = 100;
+
 typedef struct sim_stats {
     uint64_t reads;
     uint64_t writes;
@@ -58,11 +147,122 @@ typedef struct sim_stats {
     double read_miss_ratio_l2;
     double avg_access_time_l1;
     double avg_access_time_l2;
+    // Write buffer. writes_l2 only counts the writes it drains into the L2
+    uint64_t writes_absorbed_write_buffer;
+    uint64_t drains_write_buffer;
+    uint64_t capacity_drains_write_buffer;
+    uint64_t timeout_drains_write_buffer;
+    uint64_t conflict_drains_write_buffer;
+    uint64_t flush_drains_write_buffer;
+    double stall_cycles_write_buffer;
+    // Bytes moved between levels. The L1 side includes the victim cache, and
+    // L2 misses are filled straight from DRAM into L1
+    uint64_t bytes_read_l2;
+    uint64_t bytes_written_l2;
+    uint64_t bytes_read_dram;
+    uint64_t bytes_written_dram;
+    // L1 victims moved into the victim cache, and victim cache hits moved
+    // back into L1
+    uint64_t bytes_l1_to_victim_cache;
+    uint64_t bytes_victim_cache_to_l1;
+    // Cycles requests waited for the L1/victim cache to L2 and the DRAM
+    // links, and cycles the links were busy
+    double queue_cycles_l2;
+    double queue_cycles_dram;
+    double busy_cycles_l2;
+    double busy_cycles_dram;
+    // Modeled latency of every access, in LATENCY_UNITS_PER_CYCLE units: the
+    // L1 hit time for L1 and victim cache hits, plus the L2 hit time when the
+    // L2 is looked up, plus DRAM_ACCESS_PENALTY when it misses, plus the
+    // cycles the fill waited on the links and the write buffer
+    uint64_t latency_total;
+    uint64_t latency_max;
+    uint64_t latency_histogram[LATENCY_BUCKETS];
+    // Address translation. The STLB is looked up on every DTLB miss. Walk
+    // references are the page table entry reads of page walks, which go
+    // to L2 without passing through L1 and are not counted as L2 reads.
+    // Translation cycles are the STLB hit times and walk latencies, which add
+    // to the latency of the accesses that needed them
+    uint64_t accesses_dtlb;
+    uint64_t misses_dtlb;
+    uint64_t misses_stlb;
+    uint64_t page_walks;
+    uint64_t walk_references;
+    uint64_t walk_references_dram;
+    double translation_cycles;
+    double miss_ratio_dtlb;
+    double miss_ratio_stlb;
+    double avg_translation_time;
+    // Way prediction. Hits found in the way the predictor picked, over every
+    // L1 access and over L2 reads (as the L2 access time counts reads).
+    // Accuracies are over hits
+    uint64_t way_predicted_hits_l1;
+    uint64_t way_predicted_read_hits_l2;
+    double way_prediction_accuracy_l1;
+    double way_prediction_accuracy_l2;
+    // Filled in by sim_finish and owned by the simulator. L2 accesses are the
+    // lookups made after an L1 and victim cache miss
+    uint64_t num_sets_l1;
+    uint64_t num_sets_l2;
+    const set_stats_t *set_stats_l1;
+    const set_stats_t *set_stats_l2;
 } sim_stats_t;
 
+// A request leaving the L1 side (L1 and victim cache) for the L2. Misses carry
+// the accessed address, evictions the L1 block address of the victim and its
+// sector masks. access is the L1 access count when the request was made
+typedef enum l2_event_type {
+    L2_EVENT_MISS,
+    L2_EVENT_EVICT,
+} l2_event_type_t;
+
+typedef struct l2_event {
+    l2_event_type_t type;
+    char rw;
+    uint64_t addr;
+    uint64_t access;
+    uint64_t valid;
+    uint64_t dirty;
+} l2_event_t;
+
+typedef void (*l2_hook_t)(const l2_event_t *event, void *arg);
+
 extern void sim_setup(sim_config_t *config);
 extern void sim_access(char rw, uint64_t addr, sim_stats_t* p_stats);
 extern void sim_finish(sim_stats_t *p_stats);
+// Simulates count accesses in a row exactly as count calls to sim_access
+// would. They only need to agree on rw and on the L1 sector (the block, when
+// unsectored) they fall in, and addr is the first one's
+extern void sim_access_run(char rw, uint64_t addr, uint64_t count, sim_stats_t* p_stats);
+// sim_access for OPT caches. next_use is the index of the next access to the
+// same L1 block, in accesses from the start of the trace, or NO_NEXT_USE if
+// there is none (see trace_next_uses). An L2 block is ranked by the next use
+// of the L1 block that last moved into it, as the exclusive L2 is only
+// filled by L1 victims
+extern void sim_access_opt(char rw, uint64_t addr, uint64_t next_use, sim_stats_t* p_stats);
+
+// Set-partitioned simulation. Returns how many address bits, starting at bit
+// *shift, index both the L1 and the L2 sets. Accesses that differ in those bits
+// never touch the same set, so each shard can be simulated on its own thread
+// (the simulator state is per thread) and the counters merged afterwards.
+// Returns 0 when the configuration cannot be split
+extern uint64_t sim_shard_bits(const sim_config_t *config, uint64_t *shift);
+extern void sim_merge_stats(sim_stats_t *total, const sim_stats_t *shard);
+extern void sim_merge_set_stats(set_stats_t *total, const set_stats_t *shard);
+// Fills in the hit and miss ratios and average access times from the
+// counters, as sim_finish does. For stats merged from shards or a replay
+extern void sim_compute_ratios(const sim_config_t *config, sim_stats_t *stats);
+// Smallest latency (in cycles) at least fraction p of the accesses took no
+// longer than, to the precision of its histogram bucket
+extern double sim_latency_percentile(const sim_stats_t *stats, double p);
+
+// L2 sweeps. With a hook set, sim_access hands every request leaving the L1
+// side to the hook instead of simulating the L2, so the stats only cover L1
+// and the victim cache. Replaying the recorded requests with sim_replay (under
+// the same L1 and victim cache) adds the L2 side, and merging the two gives
+// the stats of a full run
+extern void sim_set_l2_hook(l2_hook_t hook, void *arg);
+extern void sim_replay(const l2_event_t *event, sim_stats_t *p_stats);
 
 // Sorry about the /* comments */. C++11 cannot handle basic C99 syntax,
 // unfortunately
@@ -72,7 +272,10 @@ static const sim_config_t DEFAULT_SIM_CONFIG = {
                       /*.b =*/ 6,  // 64-byte blocks
                       /*.s =*/ 1,  // 2-way
                       /*.insert_policy =*/ INSERT_POLICY_MIP,
-                      /*.write_strat =*/ WRITE_STRAT_WBWA},
+                      /*.write_strat =*/ WRITE_STRAT_WBWA,
+                      /*.index_func =*/ INDEX_FUNC_MODULO,
+                      /*.sector_b =*/ 0,
+                      /*.way_prediction =*/ 0},
 
     /*.victim_cache_entries =*/ 2,
 
@@ -81,7 +284,27 @@ static const sim_config_t DEFAULT_SIM_CONFIG = {
                       /*.b =*/ 6,  // 64-byte blocks
                       /*.s =*/ 3,  // 8-way
                       /*.insert_policy =*/ INSERT_POLICY_LIP,
-                      /*.write_strat =*/ WRITE_STRAT_WTWNA}
+                      /*.write_strat =*/ WRITE_STRAT_WTWNA,
+                      /*.index_func =*/ INDEX_FUNC_MODULO,
+                      /*.sector_b =*/ 0,
+                      /*.way_prediction =*/ 0},
+
+    /*.write_buffer_entries =*/ 0,
+    /*.write_buffer_timeout =*/ 0,
+
+    /*.l2_bandwidth =*/ 0,
+    /*.dram_bandwidth =*/ 0,
+    /*.access_interval =*/ 1,
+
+    /*.dtlb_config =*/ {/*.disabled =*/ 1,
+                        /*.e =*/ 6, // 64 entries
+                        /*.s =*/ 2}, // 4-way
+
+    /*.stlb_config =*/ {/*.disabled =*/ 1,
+                        /*.e =*/ 10, // 1024 entries
+                        /*.s =*/ 3}, // 8-way
+
+    /*.page_b =*/ 12 // 4KB pages
 };
 
 // Argument to cache_access rw. Indicates a load
@@ -100,4 +323,28 @@ static const double L1_HIT_TIME_PER_S = 0.2;
 static const double L2_HIT_TIME_CONST = 8;
 static const double L2_HIT_TIME_PER_S = 0.8;
 
+static const uint64_t MAX_WRITE_BUFFER_ENTRIES = 64;
+
+// A DTLB hit is hidden behind the L1 lookup. A DTLB miss adds the STLB hit
+// time, and an STLB miss adds the page walk on top of that
+static const double STLB_HIT_TIME = 7;
+// Page tables are radix trees over 48-bit virtual addresses with 512 eight
+// byte entries per table, placed from PAGE_TABLE_BASE upwards
+static const int VIRTUAL_ADDRESS_BITS = 48;
+static const int PAGE_TABLE_INDEX_BITS = 9;
+static const uint64_t PAGE_TABLE_ENTRY_BYTES = 8;
+static const uint64_t PAGE_TABLE_BASE = (uint64_t) 0xf << 56;
+
+// Next use of a block that is never accessed again
+static const uint64_t NO_NEXT_USE = UINT64_MAX;
+
+// splitmix64 finalizer, spreads nearby block addresses over the hash range.
+// Used to sample and sketch blocks for the miss ratio curve and footprint
+static inline uint64_t hash_block(uint64_t block) {
+    block += 0x9e3779b97f4a7c15ull;
+    block = (block ^ (block >> 30)) * 0xbf58476d1ce4e5b9ull;
+    block = (block ^ (block >> 27)) * 0x94d049bb133111ebull;
+    return block ^ (block >> 31);
+}
+
 #endif /* CACHESIM_HPP */
@@ -3,37 +3,231 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "cachesim.hpp"
+#include "trace.hpp"
+#include "mrc.hpp"
+#include "footprint.hpp"
 
 static void print_help(void);
 static int parse_insert_policy(const char *arg, insert_policy_t *policy_out);
+static int parse_index_func(const char *arg, index_func_t *func_out);
+static int parse_way_prediction(const char *arg, sim_config_t *config);
 static int validate_config(sim_config_t *config);
 static void print_cache_config(cache_config_t *cache_config, const char *cache_name);
 static void print_statistics(sim_stats_t* stats);
+static void print_write_buffer_statistics(sim_stats_t* stats);
+static void print_tlb_config(tlb_config_t *tlb_config, const char *tlb_name);
+static void print_tlb_statistics(sim_stats_t* stats, bool stlb_enabled);
+static void print_way_prediction_statistics(sim_stats_t* stats, sim_config_t *config);
+static void print_traffic_statistics(sim_stats_t* stats, bool l2_enabled);
+static void print_queueing_statistics(sim_stats_t* stats, sim_config_t *config);
+static void print_latency_statistics(sim_stats_t* stats);
+static void print_set_statistics(sim_stats_t* stats);
+static void print_hot_sets(sim_stats_t* stats, uint64_t count);
+static int write_heat_map(sim_stats_t* stats, const char *path);
+static void print_throughput(uint64_t accesses, struct timespec *start, struct timespec *end);
+static int pack_trace(FILE *text, const char *out_path);
+template <typename Sink>
+static int read_trace(FILE *text, const char *packed_path, uint64_t first, uint64_t count, int jobs, Sink& sink);
+template <typename Sink>
+static int read_trace_with_profiles(FILE *text, const char *packed_path, uint64_t first, uint64_t count, int jobs,
+                                    shards_mrc_t *mrc, footprint_t *footprint, Sink& sink);
+static int replay_stream(l2_stream_t *stream, sim_stats_t *stats);
+static void print_miss_ratio_curves(shards_mrc_t *mrc, bool l2_enabled);
+static void print_footprint(footprint_t *footprint, sim_config_t *config);
+static void simulate_opt(sim_config_t *config, const std::vector<trace_access_t>& accesses, sim_stats_t *stats);
+static void print_opt_statistics(sim_stats_t *stats, sim_stats_t *opt_stats, bool l2_enabled);
+
+/* Simulates every access on the calling thread. Runs of accesses with the
+ * same rw to the same L1 sector are handed to the simulator as one */
+typedef struct sim_sink {
+    sim_stats_t *stats;
+    uint64_t run_bits;
+    char run_rw;
+    uint64_t run_addr;
+    uint64_t run_length;
+
+    void operator()(char rw, uint64_t addr) {
+        if (run_length && rw == run_rw && (addr >> run_bits) == (run_addr >> run_bits)) {
+            run_length++;
+            return;
+        }
+        flush();
+        run_rw = rw;
+        run_addr = addr;
+        run_length = 1;
+    }
+
+    // Simulates the run still pending. Call before sim_finish
+    void flush() {
+        if (run_length) {
+            sim_access_run(run_rw, run_addr, run_length, stats);
+            run_length = 0;
+        }
+    }
+} sim_sink_t;
+
+/* Keeps a copy of every access on its way to the simulator, for runs that
+ * need the whole trace afterwards */
+template <typename Sink>
+struct trace_collector {
+    std::vector<trace_access_t> *accesses;
+    Sink *sink;
+
+    void operator()(char rw, uint64_t addr) {
+        trace_access_t access = {addr, rw};
+        accesses->push_back(access);
+        (*sink)(rw, addr);
+    }
+};
+
+/* Address bits below those that pick the L1 sector an access falls in */
+static uint64_t sector_bits(const sim_config_t *config) {
+    return config->l1_config.sector_b ? config->l1_config.sector_b : config->l1_config.b;
+}
+
+/* Set-partitioned simulation. Accesses are dealt out by their shard bits into
+ * per-shard batches, and each shard thread simulates its part of a batch with
+ * its own copy of the simulator while the next batch is being filled */
+class shard_dispatcher {
+public:
+    shard_dispatcher(sim_config_t *config, int num_shards, uint64_t shift, uint64_t bits);
+    void operator()(char rw, uint64_t addr);
+    // Simulates what is left, joins the shard threads and merges their stats.
+    // The merged per-set counters are stored in set_stats_l1/l2
+    void finish(sim_stats_t *stats, std::vector<set_stats_t>& set_stats_l1,
+                std::vector<set_stats_t>& set_stats_l2);
+
+private:
+    struct shard {
+        std::vector<trace_access_t> batches[2];
+        sim_stats_t stats;
+        std::vector<set_stats_t> set_stats_l1, set_stats_l2;
+        std::thread thread;
+        // Batches simulated so far
+        uint64_t completed;
+    };
+
+    void publish();
+    void run(shard *sh);
+    bool completed(uint64_t batches);
+
+    static const size_t batch_size = 1 << 16;
+
+    sim_config_t *config;
+    std::vector<shard> shards;
+    uint64_t shift, mask;
+    size_t filled;
+    std::mutex lock;
+    std::condition_variable published_cv, completed_cv;
+    // Batches handed to the shard threads
+    uint64_t published;
+    bool closed;
+};
+
+/* Level-pipelined simulation. The thread reading the trace simulates L1 and
+ * the victim cache, and hands the requests they send to L2 (see
+ * sim_set_l2_hook) through a bounded single-producer single-consumer ring to
+ * a thread that replays them into its own L2. Nothing flows back from L2 to
+ * L1, so the stats match a serial run */
+class l2_pipeline {
+public:
+    l2_pipeline(sim_config_t *config);
+    // An l2_hook_t, arg is the pipeline
+    static void push(const l2_event_t *event, void *arg);
+    // Waits for the L2 thread to replay what is left, and merges its stats
+    // into the L1 side stats (after sim_finish). The L2 per-set counters are
+    // stored in set_stats_l2
+    void finish(sim_stats_t *stats, std::vector<set_stats_t>& set_stats_l2);
+
+private:
+    void run();
+
+    static const size_t capacity = 1 << 12;
+
+    sim_config_t *config;
+    std::vector<l2_event_t> ring;
+    // Events pushed and popped so far. Each side keeps its own copy of the
+    // other's counter and only reloads it when the ring looks full or empty
+    alignas(64) std::atomic<uint64_t> pushed;
+    uint64_t popped_seen;
+    alignas(64) std::atomic<uint64_t> popped;
+    uint64_t pushed_seen;
+    alignas(64) std::atomic<bool> closed;
+    sim_stats_t stats;
+    std::vector<set_stats_t> set_stats_l2;
+    std::thread thread;
+};
 
 int main(int argc, char **argv) {
     sim_config_t config = DEFAULT_SIM_CONFIG;
     int opt;
+    int report_throughput = 0;
+    int report_sets = 0;
+    int report_traffic = 0;
+    int report_latency = 0;
+    int report_opt = 0;
+    int pipelined = 0;
+    int l2_b_set = 0;
+    const char *trace_path = NULL;
+    const char *pack_path = NULL;
+    int decode_jobs = 2;
+    int shards = 1;
+    const char *record_path = NULL;
+    const char *replay_path = NULL;
+    uint64_t hot_sets = 0;
+    const char *heat_map_path = NULL;
+    uint64_t mrc_blocks = 0;
+    uint64_t footprint_window = 0;
+    uint64_t first_access = 0;
+    uint64_t max_accesses = UINT64_MAX;
 
     /* Read arguments */
-    while(-1 != (opt = getopt(argc, argv, "c:b:s:v:C:S:P:Dh"))) {
+    while(-1 != (opt = getopt(argc, argv, "c:b:s:k:i:v:C:B:S:K:P:I:A:Dw:W:L:G:g:d:e:u:U:Z:F:f:z:j:a:n:p:m:M:H:X:Q:RtlOyTh"))) {
         switch(opt) {
         case 'c':
             config.l1_config.c = atoi(optarg);
             break;
         case 'b':
             config.l1_config.b = atoi(optarg);
-            config.l2_config.b = config.l1_config.b;
+            if (!l2_b_set) {
+                config.l2_config.b = config.l1_config.b;
+            }
+            break;
+        case 'k':
+            config.l1_config.sector_b = atoi(optarg);
             break;
         case 's':
             config.l1_config.s = atoi(optarg);
             break;
+        case 'i':
+            if (parse_index_func(optarg, &config.l1_config.index_func)) {
+                return 1;
+            }
+            break;
         case 'v':
             config.victim_cache_entries = atoi(optarg);
             break;
         case 'C':
             config.l2_config.c = atoi(optarg);
             break;
+        case 'B':
+            config.l2_config.b = atoi(optarg);
+            l2_b_set = 1;
+            break;
+        case 'K':
+            config.l2_config.sector_b = atoi(optarg);
+            break;
         case 'S':
             config.l2_config.s = atoi(optarg);
             break;
@@ -42,9 +236,105 @@ int main(int argc, char **argv) {
                 return 1;
             }
             break;
+        case 'I':
+            if (parse_index_func(optarg, &config.l2_config.index_func)) {
+                return 1;
+            }
+            break;
+        case 'A':
+            if (parse_way_prediction(optarg, &config)) {
+                return 1;
+            }
+            break;
         case 'D':
             config.l2_config.disabled = 1;
             break;
+        case 'd':
+            config.dtlb_config.disabled = 0;
+            config.dtlb_config.e = atoi(optarg);
+            break;
+        case 'e':
+            config.dtlb_config.s = atoi(optarg);
+            break;
+        case 'u':
+            config.stlb_config.disabled = 0;
+            config.stlb_config.e = atoi(optarg);
+            break;
+        case 'U':
+            config.stlb_config.s = atoi(optarg);
+            break;
+        case 'Z':
+            config.page_b = atoi(optarg);
+            break;
+        case 'w':
+            config.write_buffer_entries = atoi(optarg);
+            break;
+        case 'W':
+            config.write_buffer_timeout = atoi(optarg);
+            break;
+        case 'L':
+            config.l2_bandwidth = atof(optarg);
+            break;
+        case 'G':
+            config.dram_bandwidth = atof(optarg);
+            break;
+        case 'g':
+            config.access_interval = atof(optarg);
+            break;
+        case 'f':
+            trace_path = optarg;
+            break;
+        case 'z':
+            pack_path = optarg;
+            break;
+        case 'j':
+            decode_jobs = atoi(optarg);
+            break;
+        case 'p':
+            shards = atoi(optarg);
+            break;
+        case 'a':
+            first_access = strtoull(optarg, NULL, 0);
+            break;
+        case 'n':
+            max_accesses = strtoull(optarg, NULL, 0);
+            break;
+        case 'm':
+            record_path = optarg;
+            break;
+        case 'M':
+            replay_path = optarg;
+            break;
+        case 'H':
+            hot_sets = strtoull(optarg, NULL, 0);
+            break;
+        case 'X':
+            heat_map_path = optarg;
+            break;
+        case 'Q':
+            mrc_blocks = strtoull(optarg, NULL, 0);
+            break;
+        case 'F':
+            footprint_window = strtoull(optarg, NULL, 0);
+            break;
+        case 'R':
+            report_sets = 1;
+            break;
+        case 't':
+            report_traffic = 1;
+            break;
+        case 'l':
+            report_latency = 1;
+            break;
+        case 'O':
+            report_opt = 1;
+            break;
+        case 'y':
+            pipelined = 1;
+            break;
+        case 'T':
+            report_throughput = 1;
+            break;
         case 'h':
             /* Fall through */
         default:
@@ -53,38 +343,247 @@ int main(int argc, char **argv) {
         }
     }
 
+    FILE *text = stdin;
+    bool packed = false;
+    if (trace_path) {
+        packed = !pack_path && trace_is_packed(trace_path);
+        if (!packed && !(text = fopen(trace_path, "r"))) {
+            printf("Could not open trace `%s'\n", trace_path);
+            return 1;
+        }
+    }
+
+    if (pack_path) {
+        return pack_trace(text, pack_path);
+    }
+
+    /* A replay runs the L1 side the stream was recorded with */
+    l2_stream_t stream = {};
+    if (replay_path) {
+        if (l2_stream_open(replay_path, &stream)) {
+            return 1;
+        }
+        config.l1_config = stream.l1_config;
+        config.victim_cache_entries = stream.victim_cache_entries;
+        if (!l2_b_set) {
+            config.l2_config.b = config.l1_config.b;
+        }
+    }
+
+    if (decode_jobs < 0) {
+        printf("Invalid configuration! The number of decode threads must be nonnegative\n");
+        return 1;
+    }
+
     printf("Cache Settings\n");
     printf("--------------\n");
     print_cache_config(&config.l1_config, "L1");
     printf("Victim cache entries: %" PRIu64 "\n", config.victim_cache_entries);
     print_cache_config(&config.l2_config, "L2");
+    if (config.write_buffer_entries) {
+        printf("Write buffer entries: %" PRIu64 ". Timeout: %" PRIu64 " accesses\n",
+               config.write_buffer_entries, config.write_buffer_timeout);
+    }
+    if (config.l2_bandwidth || config.dram_bandwidth) {
+        printf("Bandwidth (bytes/cycle, 0 is unlimited): L2 %.3f, DRAM %.3f. Access interval: %.3f cycles\n",
+               config.l2_bandwidth, config.dram_bandwidth, config.access_interval);
+    }
+    if (!config.dtlb_config.disabled) {
+        print_tlb_config(&config.dtlb_config, "DTLB");
+        print_tlb_config(&config.stlb_config, "STLB");
+        printf("Page size: 2^%" PRIu64 " bytes\n", config.page_b);
+    }
     printf("\n");
 
     if (validate_config(&config)) {
         return 1;
     }
 
-    /* Setup the cache */
-    sim_setup(&config);
+    uint64_t shard_shift = 0;
+    uint64_t shard_bits = sim_shard_bits(&config, &shard_shift);
+    if (shards < 1 || (shards > 1 && !shard_bits)) {
+        printf("Invalid configuration! Parallel simulation needs at least one shard, no victim cache, "
+               "write buffer or bandwidth limit, modulo set indexing and at least one set index bit\n");
+        return 1;
+    }
+
+    if ((mrc_blocks || footprint_window) && replay_path) {
+        printf("Invalid configuration! Miss ratio curves and working sets need the trace, not a recorded L2 request stream\n");
+        return 1;
+    }
+
+    if (report_opt && (shards > 1 || record_path || replay_path)) {
+        printf("Invalid configuration! The OPT comparison needs the whole trace in one serial run\n");
+        return 1;
+    }
+
+    if (!config.dtlb_config.disabled && (pipelined || record_path || replay_path)) {
+        printf("Invalid configuration! Address translation cannot be split off into L2 request streams or the L2 pipeline\n");
+        return 1;
+    }
+
+    if (pipelined && (shards > 1 || record_path || replay_path || report_opt)) {
+        printf("Invalid configuration! The L2 pipeline cannot be combined with shards, L2 request streams or OPT\n");
+        return 1;
+    }
+
+    if (shards > 1 && (record_path || replay_path)) {
+        printf("Invalid configuration! L2 request streams cannot be recorded or replayed in parallel\n");
+        return 1;
+    }
 
     /* Setup statistics */
     sim_stats_t stats;
     memset(&stats, 0, sizeof stats);
+    std::vector<set_stats_t> set_stats_l1, set_stats_l2;
 
     /* Begin reading the file */
-    char rw;
-    uint64_t address;
-    while (!feof(stdin)) {
-        int ret = fscanf(stdin, "%c 0x%" PRIx64 "\n", &rw, &address);
-        if(ret == 2) {
-            sim_access(rw, address, &stats);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    const char *packed_path = packed ? trace_path : NULL;
+    shards_mrc_t mrc_storage[2];
+    shards_mrc_t *mrc = NULL;
+    if (mrc_blocks) {
+        mrc = mrc_storage;
+        shards_init(&mrc[0], config.l1_config.b, mrc_blocks);
+        shards_init(&mrc[1], config.l2_config.b, mrc_blocks);
+    }
+    static footprint_t footprint_storage;
+    footprint_t *footprint = NULL;
+    if (footprint_window) {
+        footprint = &footprint_storage;
+        footprint_init(footprint, config.l1_config.b, config.page_b, footprint_window);
+    }
+    l2_stream_writer_t writer;
+    std::vector<trace_access_t> accesses;
+    sim_stats_t opt_stats;
+    memset(&opt_stats, 0, sizeof opt_stats);
+    int ret;
+    if (replay_path) {
+        sim_setup(&config);
+        ret = replay_stream(&stream, &stats);
+        sim_finish(&stats);
+
+        /* Add the L1 side of the recording run */
+        sim_merge_stats(&stats, &stream.stats);
+        stats.num_sets_l1 = stream.stats.num_sets_l1;
+        stats.set_stats_l1 = stream.stats.set_stats_l1;
+        sim_compute_ratios(&config, &stats);
+    } else if (record_path) {
+        if (l2_stream_create(record_path, &config, &writer)) {
+            return 1;
         }
+        sim_setup(&config);
+        sim_set_l2_hook(l2_stream_write, &writer);
+        sim_sink sink = {&stats, sector_bits(&config)};
+        ret = read_trace_with_profiles(text, packed_path, first_access, max_accesses, decode_jobs, mrc, footprint, sink);
+        sink.flush();
+        sim_finish(&stats);
+        ret |= l2_stream_finish(&writer, &stats);
+    } else if (shards > 1) {
+        shard_dispatcher dispatcher(&config, shards, shard_shift, shard_bits);
+        ret = read_trace_with_profiles(text, packed_path, first_access, max_accesses, decode_jobs, mrc, footprint, dispatcher);
+        dispatcher.finish(&stats, set_stats_l1, set_stats_l2);
+        sim_compute_ratios(&config, &stats);
+    } else if (pipelined) {
+        sim_setup(&config);
+        l2_pipeline pipeline(&config);
+        sim_set_l2_hook(l2_pipeline::push, &pipeline);
+        sim_sink sink = {&stats, sector_bits(&config)};
+        ret = read_trace_with_profiles(text, packed_path, first_access, max_accesses, decode_jobs, mrc, footprint, sink);
+        sink.flush();
+        sim_finish(&stats);
+        pipeline.finish(&stats, set_stats_l2);
+        sim_compute_ratios(&config, &stats);
+    } else if (report_opt) {
+        sim_setup(&config);
+        sim_sink sink = {&stats, sector_bits(&config)};
+        trace_collector<sim_sink> collector = {&accesses, &sink};
+        ret = read_trace_with_profiles(text, packed_path, first_access, max_accesses, decode_jobs, mrc, footprint, collector);
+        sink.flush();
+        sim_finish(&stats);
+        if (!ret) {
+            simulate_opt(&config, accesses, &opt_stats);
+        }
+    } else {
+        sim_setup(&config);
+        sim_sink sink = {&stats, sector_bits(&config)};
+        ret = read_trace_with_profiles(text, packed_path, first_access, max_accesses, decode_jobs, mrc, footprint, sink);
+        sink.flush();
+        sim_finish(&stats);
     }
 
-    sim_finish(&stats);
+    if (ret) {
+        return 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (record_path) {
+        printf("Recorded %" PRIu64 " L2 requests from %" PRIu64 " accesses into %s\n",
+               writer.events, stats.accesses_l1, record_path);
+        if (report_throughput) {
+            print_throughput(stats.accesses_l1, &start, &end);
+        }
+        return 0;
+    }
 
     print_statistics(&stats);
 
+    if (config.write_buffer_entries) {
+        print_write_buffer_statistics(&stats);
+    }
+
+    if (!config.dtlb_config.disabled) {
+        print_tlb_statistics(&stats, !config.stlb_config.disabled);
+    }
+
+    if (config.l1_config.way_prediction || (config.l2_config.way_prediction && !config.l2_config.disabled)) {
+        print_way_prediction_statistics(&stats, &config);
+    }
+
+    if (report_traffic) {
+        print_traffic_statistics(&stats, !config.l2_config.disabled);
+    }
+
+    if (config.l2_bandwidth || config.dram_bandwidth) {
+        print_queueing_statistics(&stats, &config);
+    }
+
+    if (report_latency) {
+        print_latency_statistics(&stats);
+    }
+
+    if (report_sets) {
+        print_set_statistics(&stats);
+    }
+
+    if (hot_sets) {
+        print_hot_sets(&stats, hot_sets);
+    }
+
+    if (heat_map_path && write_heat_map(&stats, heat_map_path)) {
+        return 1;
+    }
+
+    if (mrc) {
+        print_miss_ratio_curves(mrc, !config.l2_config.disabled);
+    }
+
+    if (footprint) {
+        footprint_finish(footprint);
+        print_footprint(footprint, &config);
+    }
+
+    if (report_opt) {
+        print_opt_statistics(&stats, &opt_stats, !config.l2_config.disabled);
+    }
+
+    if (report_throughput) {
+        print_throughput(stats.accesses_l1, &start, &end);
+    }
+
     return 0;
 }
 
@@ -101,25 +600,135 @@ static int parse_insert_policy(const char *arg, insert_policy_t *policy_out) {
     }
 }
 
+static int parse_index_func(const char *arg, index_func_t *func_out) {
+    if (!strcmp(arg, "mod") || !strcmp(arg, "MOD")) {
+        *func_out = INDEX_FUNC_MODULO;
+        return 0;
+    } else if (!strcmp(arg, "xor") || !strcmp(arg, "XOR")) {
+        *func_out = INDEX_FUNC_XOR;
+        return 0;
+    } else if (!strcmp(arg, "prime") || !strcmp(arg, "PRIME")) {
+        *func_out = INDEX_FUNC_PRIME;
+        return 0;
+    } else if (!strcmp(arg, "skew") || !strcmp(arg, "SKEW")) {
+        *func_out = INDEX_FUNC_SKEW;
+        return 0;
+    } else {
+        printf("Unknown set index function `%s'\n", arg);
+        return 1;
+    }
+}
+
+/* Which levels predict ways: a '1' for L1 and a '2' for L2 */
+static int parse_way_prediction(const char *arg, sim_config_t *config) {
+    if (!*arg || strspn(arg, "12") != strlen(arg)) {
+        printf("Unknown way prediction levels `%s'\n", arg);
+        return 1;
+    }
+    config->l1_config.way_prediction = strchr(arg, '1') != NULL;
+    config->l2_config.way_prediction = strchr(arg, '2') != NULL;
+    return 0;
+}
+
 static void print_help(void) {
     printf("cachesim [OPTIONS] < traces/file.trace\n");
+    printf("cachesim [OPTIONS] -f traces/file.{trace,ctrz}\n");
     printf("-h\t\tThis helpful output\n");
     printf("L1 parameters:\n");
     printf("  -c C1\t\tTotal size for L1 in bytes is 2^C1\n");
-    printf("  -b B1\t\tSize of each block for L1 in bytes is 2^B1\n");
+    printf("  -b B1\t\tSize of each block for L1 in bytes is 2^B1 (and for L2 unless -B is given)\n");
     printf("  -s S1\t\tNumber of blocks per set for L1 is 2^S1\n");
+    printf("  -k K1\t\tSectored L1 with 2^K1 byte sectors\n");
+    printf("  -i I1\t\tSet index function for L1 (mod, xor, prime or skew)\n");
     printf("Victim cache parameters:\n");
     printf("  -v V\t\tVictim cache has V blocks/entries\n");
     printf("L2 parameters:\n");
     printf("  -C C2\t\tTotal size in bytes for L2 is 2^C1\n");
+    printf("  -B B2\t\tSize of each block for L2 in bytes is 2^B2\n");
     printf("  -S S2\t\tNumber of blocks per set for L2 is 2^S1\n");
+    printf("  -K K2\t\tSectored L2 with 2^K2 byte sectors\n");
     printf("  -P P2\t\tInsertion policy for L2 (mip or lip)\n");
+    printf("  -I I2\t\tSet index function for L2 (mod, xor, prime or skew)\n");
     printf("  -D   \t\tDisable L2 cache\n");
+    printf("  -A L \t\tPredict the MRU way in L1 (1), L2 (2) or both (12)\n");
+    printf("Write buffer parameters:\n");
+    printf("  -w W\t\tWrite-combining buffer in front of L2 has W entries (0 disables)\n");
+    printf("  -W T\t\tWrite buffer entries drain after T accesses (0 never times out)\n");
+    printf("Bandwidth parameters:\n");
+    printf("  -L BW\t\tLink between L1/victim cache and L2 moves BW bytes per cycle (0 is unlimited)\n");
+    printf("  -G BW\t\tLink to DRAM moves BW bytes per cycle (0 is unlimited)\n");
+    printf("  -g N \t\tAn access arrives every N cycles (default 1)\n");
+    printf("TLB parameters:\n");
+    printf("  -d E \t\tTranslate addresses through a DTLB with 2^E entries\n");
+    printf("  -e S \t\tNumber of entries per DTLB set is 2^S\n");
+    printf("  -u E \t\tBack the DTLB with an STLB with 2^E entries\n");
+    printf("  -U S \t\tNumber of entries per STLB set is 2^S\n");
+    printf("  -Z P \t\tPages are 2^P bytes: 12 (4KB), 21 (2MB) or 30 (1GB)\n");
+    printf("Reporting:\n");
+    printf("  -R   \t\tPrint per-set access and miss counts\n");
+    printf("  -t   \t\tPrint bytes moved between levels, in total and per access\n");
+    printf("  -l   \t\tPrint the distribution of access latencies, with tail percentiles\n");
+    printf("  -H K \t\tPrint the K sets per level with the most misses and the blocks thrashing them\n");
+    printf("  -X FILE\tWrite per-set accesses, misses and evictions of every level to FILE as CSV\n");
+    printf("  -Q N \t\tPrint approximate fully associative LRU miss ratio curves, sampling at most N blocks\n");
+    printf("  -F N \t\tPrint the distinct blocks and pages touched (and written) in every window of N accesses\n");
+    printf("  -O   \t\tSimulate the trace again with Belady's OPT replacement in L1 and L2 and print the headroom\n");
+    printf("Trace input:\n");
+    printf("  -f FILE\tRead the trace from FILE (text or packed) instead of stdin\n");
+    printf("  -z FILE\tPack the text trace into FILE and exit\n");
+    printf("  -j J\t\tDecode packed traces with J threads ahead of the simulation (0 decodes inline)\n");
+    printf("  -a A\t\tStart simulating at access A (0-based)\n");
+    printf("  -n N\t\tSimulate at most N accesses\n");
+    printf("  -p P\t\tSplit the trace by set index into P shards simulated in parallel\n");
+    printf("  -y   \t\tSimulate L2 on its own thread, fed the L1 and victim cache requests through a queue\n");
+    printf("L2 sweeps:\n");
+    printf("  -m FILE\tRecord the requests L1 and the victim cache send to L2 into FILE\n");
+    printf("  -M FILE\tReplay recorded L2 requests instead of a trace (L1 and victim cache come from FILE)\n");
+    printf("Benchmarking:\n");
+    printf("  -T   \t\tPrint throughput and peak RSS as JSON to stderr\n");
+}
+
+/* Unsectored blocks must satisfy 4 <= B <= 7. Sectored blocks may be larger,
+ * as long as the sectors do and a block has at most 64 of them */
+static int validate_block_config(cache_config_t *cache_config, const char *cache_name) {
+    if (!cache_config->sector_b) {
+        if (cache_config->b > 7 || cache_config->b < 4) {
+            printf("Invalid configuration! The block size must be reasonable: 4 <= B <= 7\n");
+            return 1;
+        }
+        return 0;
+    }
+
+    if (cache_config->sector_b > 7 || cache_config->sector_b < 4) {
+        printf("Invalid configuration! The %s sector size must be reasonable: 4 <= K <= 7\n", cache_name);
+        return 1;
+    }
+
+    if (cache_config->sector_b > cache_config->b || cache_config->b - cache_config->sector_b > 6) {
+        printf("Invalid configuration! %s blocks must hold between 1 and 64 sectors: K <= B <= K + 6\n", cache_name);
+        return 1;
+    }
+
+    return 0;
 }
 
 static int validate_config(sim_config_t *config) {
-    if (config->l1_config.b > 7 || config->l1_config.b < 4) {
-        printf("Invalid configuration! The block size must be reasonable: 4 <= B <= 7\n");
+    if (validate_block_config(&config->l1_config, "L1")) {
+        return 1;
+    }
+
+    if (!config->l2_config.disabled && validate_block_config(&config->l2_config, "L2")) {
+        return 1;
+    }
+
+    if (config->l1_config.c < config->l1_config.b + config->l1_config.s
+        || (!config->l2_config.disabled && config->l2_config.c < config->l2_config.b + config->l2_config.s)) {
+        printf("Invalid configuration! Each cache must have at least one set: C >= B + S\n");
+        return 1;
+    }
+
+    if (!config->l2_config.disabled && config->l1_config.b > config->l2_config.b) {
+        printf("Invalid configuration! L2 blocks must be at least as large as L1 blocks\n");
         return 1;
     }
 
@@ -138,6 +747,38 @@ static int validate_config(sim_config_t *config) {
         return 1;
     }
 
+    if (config->write_buffer_entries > MAX_WRITE_BUFFER_ENTRIES) {
+        printf("Invalid configuration! Write buffer entries must be at most %" PRIu64 "\n", MAX_WRITE_BUFFER_ENTRIES);
+        return 1;
+    }
+
+    if (config->l2_config.disabled && config->write_buffer_entries) {
+        printf("Invalid configuration! The write buffer sits in front of L2, which is disabled\n");
+        return 1;
+    }
+
+    if (!config->dtlb_config.disabled) {
+        if (config->page_b != 12 && config->page_b != 21 && config->page_b != 30) {
+            printf("Invalid configuration! Pages must be 4KB, 2MB or 1GB: P is 12, 21 or 30\n");
+            return 1;
+        }
+        if (config->dtlb_config.e < config->dtlb_config.s || config->dtlb_config.e > 30
+            || (!config->stlb_config.disabled
+                && (config->stlb_config.e < config->stlb_config.s || config->stlb_config.e > 30))) {
+            printf("Invalid configuration! Each TLB must have at least one set and at most 2^30 entries: S <= E <= 30\n");
+            return 1;
+        }
+    }
+    else if (!config->stlb_config.disabled) {
+        printf("Invalid configuration! The STLB backs the DTLB, which is disabled\n");
+        return 1;
+    }
+
+    if (config->l2_bandwidth < 0 || config->dram_bandwidth < 0 || !(config->access_interval > 0)) {
+        printf("Invalid configuration! Bandwidths must be nonnegative and the access interval positive\n");
+        return 1;
+    }
+
     return 0;
 }
 
@@ -145,18 +786,41 @@ static const char *insert_policy_str(insert_policy_t policy) {
     switch (policy) {
         case INSERT_POLICY_MIP: return "MIP";
         case INSERT_POLICY_LIP: return "LIP";
+        case INSERT_POLICY_OPT: return "OPT";
         default: return "Unknown policy";
     }
 }
 
+static const char *index_func_str(index_func_t func) {
+    switch (func) {
+        case INDEX_FUNC_MODULO: return "MOD";
+        case INDEX_FUNC_XOR: return "XOR";
+        case INDEX_FUNC_PRIME: return "PRIME";
+        case INDEX_FUNC_SKEW: return "SKEW";
+        default: return "Unknown index function";
+    }
+}
+
 static void print_cache_config(cache_config_t *cache_config, const char *cache_name) {
     printf("%s ", cache_name);
     if (cache_config->disabled) {
         printf("disabled\n");
     } else {
-        printf("(C,B,S): (%" PRIu64 ",%" PRIu64 ",%" PRIu64 "). Insertion policy: %s\n",
+        printf("(C,B,S): (%" PRIu64 ",%" PRIu64 ",%" PRIu64 "). Insertion policy: %s",
            cache_config->c, cache_config->b, cache_config->s,
            insert_policy_str(cache_config->insert_policy));
+        /* Only mention the index function when it isn't the conventional one,
+         * so default output is unchanged */
+        if (cache_config->index_func != INDEX_FUNC_MODULO) {
+            printf(". Index function: %s", index_func_str(cache_config->index_func));
+        }
+        if (cache_config->sector_b) {
+            printf(". Sector size: 2^%" PRIu64 " bytes", cache_config->sector_b);
+        }
+        if (cache_config->way_prediction) {
+            printf(". Way prediction: MRU");
+        }
+        printf("\n");
     }
 }
 
@@ -187,3 +851,675 @@ static void print_statistics(sim_stats_t* stats) {
     printf("L2 read miss ratio: %.3f\n", stats->read_miss_ratio_l2);
     printf("L2 average access time (AAT): %.3f\n", stats->avg_access_time_l2);
 }
+
+static void print_write_buffer_statistics(sim_stats_t* stats) {
+    printf("\n");
+    printf("Write buffer writes absorbed: %" PRIu64 "\n", stats->writes_absorbed_write_buffer);
+    printf("Write buffer drains: %" PRIu64 " (capacity %" PRIu64 ", timeout %" PRIu64 ", conflict %" PRIu64 ", flush %" PRIu64 ")\n",
+           stats->drains_write_buffer, stats->capacity_drains_write_buffer, stats->timeout_drains_write_buffer,
+           stats->conflict_drains_write_buffer, stats->flush_drains_write_buffer);
+    printf("Write buffer stall cycles: %.3f\n", stats->stall_cycles_write_buffer);
+}
+
+static void print_tlb_config(tlb_config_t *tlb_config, const char *tlb_name) {
+    if (tlb_config->disabled) {
+        printf("%s disabled\n", tlb_name);
+    } else {
+        printf("%s (E,S): (%" PRIu64 ",%" PRIu64 ")\n", tlb_name, tlb_config->e, tlb_config->s);
+    }
+}
+
+static void print_tlb_statistics(sim_stats_t* stats, bool stlb_enabled) {
+    printf("\n");
+    printf("DTLB accesses: %" PRIu64 "\n", stats->accesses_dtlb);
+    printf("DTLB misses: %" PRIu64 "\n", stats->misses_dtlb);
+    printf("DTLB miss ratio: %.3f\n", stats->miss_ratio_dtlb);
+    if (stlb_enabled) {
+        printf("STLB misses after DTLB miss: %" PRIu64 "\n", stats->misses_stlb);
+        printf("STLB miss ratio: %.3f\n", stats->miss_ratio_stlb);
+    }
+    printf("Page walks: %" PRIu64 "\n", stats->page_walks);
+    printf("Page walk references: %" PRIu64 " (%" PRIu64 " from DRAM)\n", stats->walk_references,
+           stats->walk_references_dram);
+    printf("Average translation time: %.3f\n", stats->avg_translation_time);
+}
+
+/* Prediction accuracy, and what the average access times would be if every
+ * lookup probed all ways at once */
+static void print_way_prediction_statistics(sim_stats_t* stats, sim_config_t *config) {
+    sim_config_t parallel_config = *config;
+    parallel_config.l1_config.way_prediction = 0;
+    parallel_config.l2_config.way_prediction = 0;
+    sim_stats_t parallel = *stats;
+    sim_compute_ratios(&parallel_config, &parallel);
+
+    printf("\n");
+    if (config->l1_config.way_prediction) {
+        printf("L1 way predicted hits: %" PRIu64 "\n", stats->way_predicted_hits_l1);
+        printf("L1 way prediction accuracy: %.3f\n", stats->way_prediction_accuracy_l1);
+    }
+    if (config->l2_config.way_prediction && !config->l2_config.disabled) {
+        printf("L2 way predicted read hits: %" PRIu64 "\n", stats->way_predicted_read_hits_l2);
+        printf("L2 way prediction accuracy: %.3f\n", stats->way_prediction_accuracy_l2);
+    }
+    printf("L1 average access time (AAT) probing all ways in parallel: %.3f\n", parallel.avg_access_time_l1);
+    printf("L2 average access time (AAT) probing all ways in parallel: %.3f\n", parallel.avg_access_time_l2);
+}
+
+static void print_traffic_row(const char *link, uint64_t bytes, uint64_t accesses) {
+    printf("%s: %" PRIu64 " bytes, %.3f per access, %.1f per 1000 accesses\n", link, bytes,
+           accesses ? (double) bytes / accesses : 0.0, accesses ? 1000.0 * bytes / accesses : 0.0);
+}
+
+static void print_traffic_statistics(sim_stats_t* stats, bool l2_enabled) {
+    uint64_t accesses = stats->accesses_l1;
+    printf("\n");
+    printf("Traffic\n");
+    printf("-------\n");
+    print_traffic_row("L1 to Victim Cache (L1 victims)", stats->bytes_l1_to_victim_cache, accesses);
+    print_traffic_row("Victim Cache to L1 (victim cache hits)", stats->bytes_victim_cache_to_l1, accesses);
+    if (l2_enabled) {
+        print_traffic_row("L2 to L1 (fills)", stats->bytes_read_l2, accesses);
+        print_traffic_row("L1 or Victim Cache to L2 (write-backs)", stats->bytes_written_l2, accesses);
+        print_traffic_row("DRAM to L1 (fills)", stats->bytes_read_dram, accesses);
+        print_traffic_row("L2 to DRAM (write-throughs)", stats->bytes_written_dram, accesses);
+    }
+    else {
+        print_traffic_row("DRAM to L1 (fills)", stats->bytes_read_dram, accesses);
+        print_traffic_row("L1 or Victim Cache to DRAM (write-backs)", stats->bytes_written_dram, accesses);
+    }
+}
+
+/* Load is busy cycles over the time the trace takes to arrive. Above 1 the
+ * link cannot keep up and the queue keeps growing */
+static void print_queueing_statistics(sim_stats_t* stats, sim_config_t *config) {
+    double cycles = stats->accesses_l1 * config->access_interval;
+    double accesses = stats->accesses_l1 ? stats->accesses_l1 : 1;
+    printf("\n");
+    printf("Queueing\n");
+    printf("--------\n");
+    if (config->l2_bandwidth) {
+        printf("L2 link load: %.3f\n", cycles > 0 ? stats->busy_cycles_l2 / cycles : 0.0);
+        printf("L2 link queueing delay: %.3f cycles total, %.3f per access\n", stats->queue_cycles_l2,
+               stats->queue_cycles_l2 / accesses);
+    }
+    if (config->dram_bandwidth) {
+        printf("DRAM link load: %.3f\n", cycles > 0 ? stats->busy_cycles_dram / cycles : 0.0);
+        printf("DRAM link queueing delay: %.3f cycles total, %.3f per access\n", stats->queue_cycles_dram,
+               stats->queue_cycles_dram / accesses);
+    }
+}
+
+/* Percentiles are the top of the histogram bucket the access falls in, so
+ * they can overstate the exact latency by up to 1/32 */
+static void print_latency_statistics(sim_stats_t* stats) {
+    static const double percentiles[] = {0.5, 0.9, 0.99, 0.999};
+    printf("\n");
+    printf("Access Latency\n");
+    printf("--------------\n");
+    printf("Mean latency: %.3f cycles\n", stats->accesses_l1
+           ? stats->latency_total / LATENCY_UNITS_PER_CYCLE / stats->accesses_l1 : 0.0);
+    for (size_t i = 0; i < sizeof percentiles / sizeof percentiles[0]; i++) {
+        printf("p%g latency: %.3f cycles\n", 100 * percentiles[i], sim_latency_percentile(stats, percentiles[i]));
+    }
+    printf("Max latency: %.3f cycles\n", stats->latency_max / LATENCY_UNITS_PER_CYCLE);
+}
+
+static void print_level_set_statistics(const char *cache_name, uint64_t num_sets, const set_stats_t *sets) {
+    uint64_t touched = 0, total_accesses = 0, total_misses = 0, total_evictions = 0;
+    uint64_t max_accesses = 0, max_misses = 0, max_evictions = 0;
+    for (uint64_t i = 0; i < num_sets; i++) {
+        touched += sets[i].accesses > 0;
+        total_accesses += sets[i].accesses;
+        total_misses += sets[i].misses;
+        total_evictions += sets[i].evictions;
+        if (sets[i].accesses > max_accesses) max_accesses = sets[i].accesses;
+        if (sets[i].misses > max_misses) max_misses = sets[i].misses;
+        if (sets[i].evictions > max_evictions) max_evictions = sets[i].evictions;
+    }
+
+    double mean_accesses = num_sets ? (double) total_accesses / num_sets : 0;
+    double mean_misses = num_sets ? (double) total_misses / num_sets : 0;
+    double mean_evictions = num_sets ? (double) total_evictions / num_sets : 0;
+
+    printf("\n");
+    printf("%s sets touched: %" PRIu64 " of %" PRIu64 "\n", cache_name, touched, num_sets);
+    printf("%s accesses per set: max %" PRIu64 ", mean %.3f, max/mean %.3f\n", cache_name,
+           max_accesses, mean_accesses, mean_accesses > 0 ? max_accesses / mean_accesses : 0);
+    printf("%s misses per set: max %" PRIu64 ", mean %.3f, max/mean %.3f\n", cache_name,
+           max_misses, mean_misses, mean_misses > 0 ? max_misses / mean_misses : 0);
+    printf("%s evictions per set: max %" PRIu64 ", mean %.3f, max/mean %.3f\n", cache_name,
+           max_evictions, mean_evictions, mean_evictions > 0 ? max_evictions / mean_evictions : 0);
+    printf("%s set: accesses misses evictions\n", cache_name);
+    for (uint64_t i = 0; i < num_sets; i++) {
+        printf("%" PRIu64 ": %" PRIu64 " %" PRIu64 " %" PRIu64 "\n", i, sets[i].accesses, sets[i].misses,
+               sets[i].evictions);
+    }
+}
+
+static void print_set_statistics(sim_stats_t* stats) {
+    printf("\n");
+    printf("Per-set Statistics\n");
+    printf("------------------\n");
+    printf("(L2 accesses are lookups after an L1 and victim cache miss)\n");
+    print_level_set_statistics("L1", stats->num_sets_l1, stats->set_stats_l1);
+    if (stats->num_sets_l2) {
+        print_level_set_statistics("L2", stats->num_sets_l2, stats->set_stats_l2);
+    }
+}
+
+static void print_level_hot_sets(const char *cache_name, uint64_t num_sets, const set_stats_t *sets,
+                                 uint64_t count) {
+    std::vector<uint64_t> order;
+    for (uint64_t i = 0; i < num_sets; i++) {
+        if (sets[i].misses) {
+            order.push_back(i);
+        }
+    }
+    count = count < order.size() ? count : order.size();
+    std::partial_sort(order.begin(), order.begin() + count, order.end(), [sets](uint64_t a, uint64_t b) {
+        return sets[a].misses != sets[b].misses ? sets[a].misses > sets[b].misses : a < b;
+    });
+
+    printf("\n");
+    printf("%s set: accesses misses evictions (thrashing blocks: times evicted)\n", cache_name);
+    for (uint64_t i = 0; i < count; i++) {
+        const set_stats_t *set = &sets[order[i]];
+        printf("%" PRIu64 ": %" PRIu64 " %" PRIu64 " %" PRIu64, order[i], set->accesses, set->misses,
+               set->evictions);
+
+        /* the top blocks are kept unordered, print the most evicted first */
+        block_count_t blocks[SET_STATS_TOP_BLOCKS];
+        std::copy(set->top_blocks, set->top_blocks + SET_STATS_TOP_BLOCKS, blocks);
+        std::sort(blocks, blocks + SET_STATS_TOP_BLOCKS, [](const block_count_t& a, const block_count_t& b) {
+            return a.count != b.count ? a.count > b.count : a.addr < b.addr;
+        });
+        for (int j = 0; j < SET_STATS_TOP_BLOCKS && blocks[j].count > 1; j++) {
+            printf(" 0x%" PRIx64 ":%" PRIu64, blocks[j].addr, blocks[j].count);
+        }
+        printf("\n");
+    }
+}
+
+static void print_hot_sets(sim_stats_t* stats, uint64_t count) {
+    printf("\n");
+    printf("Hot Sets\n");
+    printf("--------\n");
+    printf("(the %" PRIu64 " sets per level with the most misses; a block evicted more than once keeps coming back)\n", count);
+    print_level_hot_sets("L1", stats->num_sets_l1, stats->set_stats_l1, count);
+    if (stats->num_sets_l2) {
+        print_level_hot_sets("L2", stats->num_sets_l2, stats->set_stats_l2, count);
+    }
+}
+
+/* One row per set of each level, for plotting as a heat map */
+static int write_heat_map(sim_stats_t* stats, const char *path) {
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        printf("Could not open `%s' for writing\n", path);
+        return 1;
+    }
+
+    fprintf(out, "level,set,accesses,misses,evictions\n");
+    for (uint64_t i = 0; i < stats->num_sets_l1; i++) {
+        const set_stats_t *set = &stats->set_stats_l1[i];
+        fprintf(out, "L1,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", i, set->accesses, set->misses,
+                set->evictions);
+    }
+    for (uint64_t i = 0; i < stats->num_sets_l2; i++) {
+        const set_stats_t *set = &stats->set_stats_l2[i];
+        fprintf(out, "L2,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", i, set->accesses, set->misses,
+                set->evictions);
+    }
+
+    if (fclose(out)) {
+        printf("Could not write `%s'\n", path);
+        return 1;
+    }
+    return 0;
+}
+
+static void print_miss_ratio_curve(const char *cache_name, shards_mrc_t *mrc) {
+    std::vector<mrc_point_t> curve;
+    shards_curve(mrc, curve);
+
+    printf("%s (2^%d-byte blocks): %" PRIu64 " references sampled, final rate %.6f, compulsory miss ratio %.4f\n",
+           cache_name, mrc->block_bits, mrc->samples, shards_rate(mrc),
+           mrc->accesses > 0 ? mrc->cold / mrc->accesses : 0.0);
+    printf("%s size: miss ratio\n", cache_name);
+    for (size_t i = 0; i < curve.size(); i++) {
+        printf("%" PRIu64 ": %.4f\n", curve[i].size, curve[i].miss_ratio);
+    }
+}
+
+static void print_miss_ratio_curves(shards_mrc_t *mrc, bool l2_enabled) {
+    printf("\n");
+    printf("Miss Ratio Curves\n");
+    printf("-----------------\n");
+    printf("(approximate, fully associative LRU; L2 is exclusive, so L2 sizes include L1 and the victim cache)\n");
+    print_miss_ratio_curve("L1", &mrc[0]);
+    if (l2_enabled) {
+        printf("\n");
+        print_miss_ratio_curve("L2", &mrc[1]);
+    }
+}
+
+/* Runs the trace again with OPT replacement in L1 and L2. The simulator
+ * state is per thread, so the OPT run gets a thread of its own and the stats
+ * of the run it is compared against stay valid */
+static void simulate_opt(sim_config_t *config, const std::vector<trace_access_t>& accesses, sim_stats_t *stats) {
+    sim_config_t opt_config = *config;
+    opt_config.l1_config.insert_policy = INSERT_POLICY_OPT;
+    opt_config.l2_config.insert_policy = INSERT_POLICY_OPT;
+
+    std::vector<uint64_t> next_uses;
+    trace_next_uses(accesses, config->l1_config.b, next_uses);
+
+    std::thread thread([&] {
+        sim_setup(&opt_config);
+        for (size_t i = 0; i < accesses.size(); i++) {
+            sim_access_opt(accesses[i].rw, accesses[i].addr, next_uses[i], stats);
+        }
+        sim_finish(stats);
+    });
+    thread.join();
+
+    /* The per-set counters went with the thread */
+    stats->num_sets_l1 = stats->num_sets_l2 = 0;
+    stats->set_stats_l1 = stats->set_stats_l2 = NULL;
+}
+
+static void print_opt_row(const char *name, double ratio, double opt_ratio) {
+    printf("%s: %.3f, OPT %.3f, headroom %.3f\n", name, ratio, opt_ratio, opt_ratio - ratio);
+}
+
+static void print_opt_statistics(sim_stats_t *stats, sim_stats_t *opt_stats, bool l2_enabled) {
+    printf("\n");
+    printf("OPT Headroom\n");
+    printf("------------\n");
+    printf("(Belady's OPT in L1 and L2 over the same trace; the victim cache stays LRU and the exclusive L2 ranks "
+           "blocks by the next use of the L1 victim filling them)\n");
+    print_opt_row("L1 hit ratio", stats->hit_ratio_l1, opt_stats->hit_ratio_l1);
+    if (l2_enabled) {
+        print_opt_row("L2 read hit ratio", stats->read_hit_ratio_l2, opt_stats->read_hit_ratio_l2);
+        printf("L2 read misses: %" PRIu64 ", OPT %" PRIu64 "\n", stats->read_misses_l2, opt_stats->read_misses_l2);
+    }
+    printf("L1 average access time (AAT): %.3f, OPT %.3f\n", stats->avg_access_time_l1, opt_stats->avg_access_time_l1);
+}
+
+/* One row per window, with its block footprint in bytes and the smallest
+ * level it fits in. L2 is exclusive, so what fits in L2 is L1, the victim
+ * cache and L2 together. A window that fits but still misses a lot is
+ * missing on conflicts, not capacity */
+static void print_footprint(footprint_t *footprint, sim_config_t *config) {
+    uint64_t l1_bytes = (uint64_t) 1 << config->l1_config.c;
+    uint64_t l2_bytes = l1_bytes + (config->victim_cache_entries << config->l1_config.b);
+    if (!config->l2_config.disabled) {
+        l2_bytes += (uint64_t) 1 << config->l2_config.c;
+    }
+
+    printf("\n");
+    printf("Working Set\n");
+    printf("-----------\n");
+    printf("(distinct 2^%d-byte blocks and 2^%d-byte pages per window of %" PRIu64 " accesses, "
+           "HyperLogLog estimates within about 2%%)\n", footprint->block_bits, footprint->page_bits,
+           footprint->window);
+    printf("first access: blocks (read-only, written), pages (read-only, written), footprint bytes, fits in\n");
+    for (size_t i = 0; i < footprint->windows.size(); i++) {
+        const footprint_window_t& window = footprint->windows[i];
+        double bytes = window.blocks * ((uint64_t) 1 << footprint->block_bits);
+        const char *fits = bytes <= l1_bytes ? "L1" : (!config->l2_config.disabled && bytes <= l2_bytes) ? "L2" : "none";
+        printf("%" PRIu64 ": %.0f (%.0f, %.0f), %.0f (%.0f, %.0f), %.0f, %s\n", window.first,
+               window.blocks, window.blocks - window.written_blocks, window.written_blocks,
+               window.pages, window.pages - window.written_pages, window.written_pages, bytes, fits);
+    }
+}
+
+/* Report simulation throughput (trace parsing included) and peak RSS as a
+ * single JSON object on stderr, so bench.sh can collect it without touching
+ * the statistics printed on stdout */
+static void print_throughput(uint64_t accesses, struct timespec *start, struct timespec *end) {
+    double seconds = (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    fprintf(stderr, "{\"accesses\": %" PRIu64 ", \"seconds\": %.6f, "
+                    "\"accesses_per_sec\": %.1f, \"ns_per_access\": %.3f, "
+                    "\"peak_rss_kb\": %ld}\n",
+            accesses, seconds,
+            seconds > 0 ? accesses / seconds : 0.0,
+            accesses ? seconds * 1e9 / accesses : 0.0,
+            usage.ru_maxrss);
+}
+
+static int pack_trace(FILE *text, const char *out_path) {
+    FILE *out = fopen(out_path, "wb");
+    if (!out) {
+        printf("Could not open `%s' for writing\n", out_path);
+        return 1;
+    }
+
+    uint64_t num_accesses;
+    int ret = trace_pack(text, out, DEFAULT_TRACE_CHUNK_SIZE, &num_accesses);
+    if (!ret && !fseek(out, 0, SEEK_END)) {
+        printf("Packed %" PRIu64 " accesses into %s (%ld bytes)\n", num_accesses, out_path, ftell(out));
+    }
+    fclose(out);
+    return ret;
+}
+
+/* Accesses decoded per call into the text reader */
+static const size_t TEXT_BATCH_SIZE = 1 << 12;
+
+template <typename Sink>
+static int read_text(FILE *text, uint64_t first, uint64_t count, Sink& sink) {
+    text_trace_t trace;
+    text_trace_open(text, &trace);
+    std::vector<trace_access_t> batch;
+    uint64_t index = 0;
+    int ret = 0;
+    while (count) {
+        batch.clear();
+        if ((ret = text_trace_read(&trace, batch, TEXT_BATCH_SIZE))) {
+            break;
+        }
+        for (size_t i = 0; i < batch.size() && count; i++) {
+            if (index++ >= first) {
+                sink(batch[i].rw, batch[i].addr);
+                count--;
+            }
+        }
+        if (batch.size() < TEXT_BATCH_SIZE) {
+            break;
+        }
+    }
+    text_trace_close(&trace);
+    return ret;
+}
+
+typedef struct decoded_chunk {
+    bool ok;
+    std::vector<trace_access_t> accesses;
+} decoded_chunk_t;
+
+static decoded_chunk_t decode_chunk(const packed_trace_t *trace, uint64_t chunk) {
+    decoded_chunk_t decoded;
+    decoded.ok = trace_decode_chunk(trace, chunk, decoded.accesses);
+    return decoded;
+}
+
+/* Chunks are decoded up to jobs ahead of the one being simulated, each on
+ * its own thread, and handed to the sink in trace order */
+template <typename Sink>
+static int read_packed(const char *path, uint64_t first, uint64_t count, int jobs, Sink& sink) {
+    packed_trace_t trace = {};
+    if (trace_open_packed(path, &trace)) {
+        return 1;
+    }
+
+    uint64_t num_chunks = trace.chunks.size();
+    uint64_t next = trace.chunk_size ? first / trace.chunk_size : num_chunks;
+    uint64_t skip = first - next * trace.chunk_size;
+    std::deque<std::future<decoded_chunk_t> > pending;
+    std::launch policy = jobs ? std::launch::async : std::launch::deferred;
+    size_t window = jobs ? jobs : 1;
+    int ret = 0;
+
+    while (count && (next < num_chunks || !pending.empty())) {
+        while (pending.size() < window && next < num_chunks) {
+            pending.push_back(std::async(policy, decode_chunk, &trace, next++));
+        }
+
+        decoded_chunk_t decoded = pending.front().get();
+        pending.pop_front();
+        if (!decoded.ok) {
+            printf("Packed trace `%s' has a corrupt chunk\n", path);
+            ret = 1;
+            break;
+        }
+
+        const std::vector<trace_access_t>& accesses = decoded.accesses;
+        for (size_t i = skip; i < accesses.size() && count; i++, count--) {
+            sink(accesses[i].rw, accesses[i].addr);
+        }
+        skip = 0;
+    }
+
+    /* Wait for chunks still being decoded before unmapping the trace */
+    pending.clear();
+    trace_close_packed(&trace);
+    return ret;
+}
+
+template <typename Sink>
+static int read_trace(FILE *text, const char *packed_path, uint64_t first, uint64_t count, int jobs, Sink& sink) {
+    if (packed_path) {
+        return read_packed(packed_path, first, count, jobs, sink);
+    }
+    return read_text(text, first, count, sink);
+}
+
+shard_dispatcher::shard_dispatcher(sim_config_t *config, int num_shards, uint64_t shift, uint64_t bits)
+    : config(config), shards(num_shards), shift(shift), mask(bits >= 64 ? ~0ull : (1ull << bits) - 1),
+      filled(0), published(0), closed(false) {
+    for (size_t i = 0; i < shards.size(); i++) {
+        shards[i].completed = 0;
+        shards[i].thread = std::thread(&shard_dispatcher::run, this, &shards[i]);
+    }
+}
+
+void shard_dispatcher::operator()(char rw, uint64_t addr) {
+    trace_access_t access = {addr, rw};
+    shards[((addr >> shift) & mask) % shards.size()].batches[published % 2].push_back(access);
+    if (++filled == batch_size) {
+        publish();
+    }
+}
+
+void shard_dispatcher::publish() {
+    std::unique_lock<std::mutex> guard(lock);
+    published++;
+    published_cv.notify_all();
+
+    /* The next batch reuses the buffers of the one before this, so wait
+     * until every shard has simulated it */
+    completed_cv.wait(guard, [this] { return completed(published - 1); });
+    filled = 0;
+}
+
+/* Whether every shard has simulated the first `batches' batches. Called
+ * with the lock held */
+bool shard_dispatcher::completed(uint64_t batches) {
+    for (size_t i = 0; i < shards.size(); i++) {
+        if (shards[i].completed < batches) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void shard_dispatcher::run(shard *sh) {
+    sim_setup(config);
+    memset(&sh->stats, 0, sizeof sh->stats);
+    sim_sink sink = {&sh->stats, sector_bits(config)};
+
+    for (uint64_t batch = 0;; batch++) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            published_cv.wait(guard, [this, batch] { return published > batch || closed; });
+            if (published == batch) {
+                break;
+            }
+        }
+
+        std::vector<trace_access_t>& accesses = sh->batches[batch % 2];
+        for (size_t i = 0; i < accesses.size(); i++) {
+            sink(accesses[i].rw, accesses[i].addr);
+        }
+        accesses.clear();
+
+        std::lock_guard<std::mutex> guard(lock);
+        sh->completed++;
+        completed_cv.notify_one();
+    }
+
+    /* The simulator state dies with this thread, so keep a copy of the
+     * per-set counters */
+    sink.flush();
+    sim_finish(&sh->stats);
+    sh->set_stats_l1.assign(sh->stats.set_stats_l1, sh->stats.set_stats_l1 + sh->stats.num_sets_l1);
+    sh->set_stats_l2.assign(sh->stats.set_stats_l2, sh->stats.set_stats_l2 + sh->stats.num_sets_l2);
+}
+
+void shard_dispatcher::finish(sim_stats_t *stats, std::vector<set_stats_t>& set_stats_l1,
+                              std::vector<set_stats_t>& set_stats_l2) {
+    if (filled) {
+        publish();
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        closed = true;
+        published_cv.notify_all();
+    }
+
+    for (size_t i = 0; i < shards.size(); i++) {
+        shards[i].thread.join();
+    }
+
+    /* Each set was only simulated by one shard, the others have zeros for it */
+    set_stats_l1.assign(shards[0].set_stats_l1.size(), set_stats_t());
+    set_stats_l2.assign(shards[0].set_stats_l2.size(), set_stats_t());
+    for (size_t i = 0; i < shards.size(); i++) {
+        sim_merge_stats(stats, &shards[i].stats);
+        for (size_t j = 0; j < set_stats_l1.size(); j++) {
+            sim_merge_set_stats(&set_stats_l1[j], &shards[i].set_stats_l1[j]);
+        }
+        for (size_t j = 0; j < set_stats_l2.size(); j++) {
+            sim_merge_set_stats(&set_stats_l2[j], &shards[i].set_stats_l2[j]);
+        }
+    }
+
+    stats->num_sets_l1 = set_stats_l1.size();
+    stats->set_stats_l1 = set_stats_l1.data();
+    stats->num_sets_l2 = set_stats_l2.size();
+    stats->set_stats_l2 = set_stats_l2.data();
+}
+
+l2_pipeline::l2_pipeline(sim_config_t *config)
+    : config(config), ring(capacity), pushed(0), popped_seen(0), popped(0), pushed_seen(0), closed(false) {
+    thread = std::thread(&l2_pipeline::run, this);
+}
+
+void l2_pipeline::push(const l2_event_t *event, void *arg) {
+    l2_pipeline *pipeline = (l2_pipeline *) arg;
+    uint64_t n = pipeline->pushed.load(std::memory_order_relaxed);
+    while (n - pipeline->popped_seen == capacity) {
+        pipeline->popped_seen = pipeline->popped.load(std::memory_order_acquire);
+        if (n - pipeline->popped_seen == capacity) {
+            std::this_thread::yield();
+        }
+    }
+    pipeline->ring[n % capacity] = *event;
+    pipeline->pushed.store(n + 1, std::memory_order_release);
+}
+
+void l2_pipeline::run() {
+    sim_setup(config);
+    memset(&stats, 0, sizeof stats);
+
+    uint64_t n = 0;
+    for (;;) {
+        /* Replay everything pushed so far before handing the slots back */
+        pushed_seen = pushed.load(std::memory_order_acquire);
+        if (n == pushed_seen) {
+            /* Closed is set after the last push, so check the ring again */
+            if (closed.load(std::memory_order_acquire) && n == pushed.load(std::memory_order_acquire)) {
+                break;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+        for (; n < pushed_seen; n++) {
+            sim_replay(&ring[n % capacity], &stats);
+        }
+        popped.store(n, std::memory_order_release);
+    }
+
+    /* The simulator state dies with this thread, so keep a copy of the
+     * per-set counters */
+    sim_finish(&stats);
+    set_stats_l2.assign(stats.set_stats_l2, stats.set_stats_l2 + stats.num_sets_l2);
+}
+
+void l2_pipeline::finish(sim_stats_t *total, std::vector<set_stats_t>& total_set_stats_l2) {
+    closed.store(true, std::memory_order_release);
+    thread.join();
+
+    sim_merge_stats(total, &stats);
+    total_set_stats_l2.swap(set_stats_l2);
+    total->num_sets_l2 = total_set_stats_l2.size();
+    total->set_stats_l2 = total_set_stats_l2.data();
+}
+
+/* Feeds every access to the L1 and L2 block size curve trackers on its way
+ * to the simulator */
+template <typename Sink>
+struct mrc_sink {
+    shards_mrc_t *mrc;
+    Sink *sink;
+
+    void operator()(char rw, uint64_t addr) {
+        shards_access(&mrc[0], addr);
+        shards_access(&mrc[1], addr);
+        (*sink)(rw, addr);
+    }
+};
+
+template <typename Sink>
+static int read_trace_with_mrc(FILE *text, const char *packed_path, uint64_t first, uint64_t count, int jobs,
+                               shards_mrc_t *mrc, Sink& sink) {
+    if (!mrc) {
+        return read_trace(text, packed_path, first, count, jobs, sink);
+    }
+    mrc_sink<Sink> tee = {mrc, &sink};
+    return read_trace(text, packed_path, first, count, jobs, tee);
+}
+
+/* Feeds every access to the working set tracker on its way to the
+ * simulator */
+template <typename Sink>
+struct footprint_sink {
+    footprint_t *footprint;
+    Sink *sink;
+
+    void operator()(char rw, uint64_t addr) {
+        footprint_access(footprint, rw, addr);
+        (*sink)(rw, addr);
+    }
+};
+
+template <typename Sink>
+static int read_trace_with_profiles(FILE *text, const char *packed_path, uint64_t first, uint64_t count, int jobs,
+                                    shards_mrc_t *mrc, footprint_t *footprint, Sink& sink) {
+    if (!footprint) {
+        return read_trace_with_mrc(text, packed_path, first, count, jobs, mrc, sink);
+    }
+    footprint_sink<Sink> tee = {footprint, &sink};
+    return read_trace_with_mrc(text, packed_path, first, count, jobs, mrc, tee);
+}
+
+static int replay_stream(l2_stream_t *stream, sim_stats_t *stats) {
+    l2_event_t event;
+    int ret;
+    while ((ret = l2_stream_next(stream, &event)) > 0) {
+        sim_replay(&event, stats);
+    }
+
+    if (ret < 0) {
+        printf("L2 request stream is corrupt\n");
+        return 1;
+    }
+    return 0;
+}
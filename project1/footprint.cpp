@@ -0,0 +1,90 @@
+#include <math.h>
+#include <string.h>
+#include "cachesim.hpp"
+#include "footprint.hpp"
+
+enum footprint_sketch {
+    SKETCH_BLOCKS,
+    SKETCH_WRITTEN_BLOCKS,
+    SKETCH_PAGES,
+    SKETCH_WRITTEN_PAGES,
+};
+
+/* the top bits of the hash pick a register, which keeps the longest run of leading zeros (plus one)
+ * seen in the rest */
+static inline void sketch_add(uint8_t *registers, uint64_t hash) {
+    uint64_t i = hash >> (64 - FOOTPRINT_HLL_BITS);
+    uint64_t rest = (hash << FOOTPRINT_HLL_BITS) | ((uint64_t) 1 << (FOOTPRINT_HLL_BITS - 1));
+    uint8_t rank = __builtin_clzll(rest) + 1;
+    if (rank > registers[i]) {
+        registers[i] = rank;
+    }
+}
+
+/* harmonic mean of the registers, with linear counting over the empty ones while the estimate is
+ * small. a 64-bit hash needs no large range correction */
+static double sketch_estimate(const uint8_t *registers) {
+    const double m = FOOTPRINT_HLL_REGISTERS;
+    double sum = 0;
+    int zeros = 0;
+    for (int i = 0; i < FOOTPRINT_HLL_REGISTERS; i++) {
+        sum += ldexp(1.0, -registers[i]);
+        zeros += !registers[i];
+    }
+
+    double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    if (estimate <= 2.5 * m && zeros) {
+        return m * log(m / zeros);
+    }
+    return estimate;
+}
+
+static void footprint_close_window(footprint_t *footprint) {
+    footprint_window_t window;
+    window.first = footprint->accesses - footprint->window_accesses;
+    window.accesses = footprint->window_accesses;
+    window.blocks = sketch_estimate(footprint->sketches[SKETCH_BLOCKS]);
+    window.written_blocks = sketch_estimate(footprint->sketches[SKETCH_WRITTEN_BLOCKS]);
+    window.pages = sketch_estimate(footprint->sketches[SKETCH_PAGES]);
+    window.written_pages = sketch_estimate(footprint->sketches[SKETCH_WRITTEN_PAGES]);
+
+    /* written blocks are a subset of all blocks, keep the estimates consistent */
+    window.written_blocks = window.written_blocks < window.blocks ? window.written_blocks : window.blocks;
+    window.written_pages = window.written_pages < window.pages ? window.written_pages : window.pages;
+    footprint->windows.push_back(window);
+
+    footprint->window_accesses = 0;
+    memset(footprint->sketches, 0, sizeof footprint->sketches);
+}
+
+void footprint_init(footprint_t *footprint, int block_bits, int page_bits, uint64_t window) {
+    footprint->block_bits = block_bits;
+    footprint->page_bits = page_bits;
+    footprint->window = window;
+    footprint->accesses = 0;
+    footprint->window_accesses = 0;
+    memset(footprint->sketches, 0, sizeof footprint->sketches);
+    footprint->windows.clear();
+}
+
+void footprint_access(footprint_t *footprint, char rw, uint64_t addr) {
+    uint64_t block = hash_block(addr >> footprint->block_bits);
+    uint64_t page = hash_block(addr >> footprint->page_bits);
+    sketch_add(footprint->sketches[SKETCH_BLOCKS], block);
+    sketch_add(footprint->sketches[SKETCH_PAGES], page);
+    if (rw == WRITE) {
+        sketch_add(footprint->sketches[SKETCH_WRITTEN_BLOCKS], block);
+        sketch_add(footprint->sketches[SKETCH_WRITTEN_PAGES], page);
+    }
+
+    footprint->accesses++;
+    if (++footprint->window_accesses == footprint->window) {
+        footprint_close_window(footprint);
+    }
+}
+
+void footprint_finish(footprint_t *footprint) {
+    if (footprint->window_accesses) {
+        footprint_close_window(footprint);
+    }
+}
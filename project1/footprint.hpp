@@ -0,0 +1,50 @@
+#ifndef FOOTPRINT_HPP
+#define FOOTPRINT_HPP
+
+#include <stdint.h>
+#include <vector>
+
+// Working set of a trace, window by window: how many distinct blocks and
+// pages each window of accesses touches, and how many of them are written.
+// The distinct counts are HyperLogLog estimates (Flajolet et al., 2007) with
+// 2^FOOTPRINT_HLL_BITS registers per sketch, within about 1.6% (one standard
+// error) of the exact count, and exact in practice for small counts where
+// linear counting takes over. Memory is fixed whatever the footprint.
+// Read-only counts are the difference between all and written ones, so they
+// carry the error of both
+
+// Distinct blocks and pages one window touched
+typedef struct footprint_window {
+    // Index of the first access in the window, and how many it holds (only
+    // the last window may hold fewer)
+    uint64_t first;
+    uint64_t accesses;
+    double blocks;
+    double written_blocks;
+    double pages;
+    double written_pages;
+} footprint_window_t;
+
+static const int FOOTPRINT_HLL_BITS = 12;
+static const int FOOTPRINT_HLL_REGISTERS = 1 << FOOTPRINT_HLL_BITS;
+
+typedef struct footprint {
+    int block_bits;
+    int page_bits;
+    uint64_t window;
+    // Accesses seen so far, in total and in the open window
+    uint64_t accesses;
+    uint64_t window_accesses;
+    // Sketches of the open window: blocks, written blocks, pages and written
+    // pages
+    uint8_t sketches[4][FOOTPRINT_HLL_REGISTERS];
+    std::vector<footprint_window_t> windows;
+} footprint_t;
+
+extern void footprint_init(footprint_t *footprint, int block_bits, int page_bits, uint64_t window);
+extern void footprint_access(footprint_t *footprint, char rw, uint64_t addr);
+// Closes the last window if it holds any accesses. Call at the end of the
+// trace
+extern void footprint_finish(footprint_t *footprint);
+
+#endif /* FOOTPRINT_HPP */
@@ -0,0 +1,136 @@
+#include <algorithm>
+#include "cachesim.hpp"
+#include "mrc.hpp"
+
+/* smallest number of last-use times the tree covers */
+static const uint64_t SHARDS_MIN_TIMES = 1 << 12;
+
+static void live_add(shards_mrc_t *mrc, uint64_t time, int64_t delta) {
+    for (uint64_t i = time + 1; i < mrc->live.size(); i += i & (0 - i)) {
+        mrc->live[i] += delta;
+    }
+}
+
+/* tracked blocks last used before time */
+static int64_t live_before(const shards_mrc_t *mrc, uint64_t time) {
+    int64_t count = 0;
+    for (uint64_t i = time; i > 0; i &= i - 1) {
+        count += mrc->live[i];
+    }
+    return count;
+}
+
+/* renumbers last uses 0, 1, ... in order once the clock runs past the tree,
+ * and sizes the tree for several rounds of reuses before the next time */
+static void live_compact(shards_mrc_t *mrc) {
+    std::vector<std::pair<uint64_t, uint64_t> > uses;
+    for (auto it = mrc->last_use.begin(); it != mrc->last_use.end(); ++it) {
+        uses.push_back(std::make_pair(it->second, it->first));
+    }
+    std::sort(uses.begin(), uses.end());
+
+    mrc->live.assign(std::max<uint64_t>(SHARDS_MIN_TIMES, 4 * uses.size()) + 1, 0);
+    for (uint64_t i = 0; i < uses.size(); i++) {
+        mrc->last_use[uses[i].second] = i;
+        live_add(mrc, i, 1);
+    }
+    mrc->clock = uses.size();
+}
+
+void shards_init(shards_mrc_t *mrc, int block_bits, uint64_t max_blocks) {
+    mrc->block_bits = block_bits;
+    mrc->max_blocks = max_blocks;
+    mrc->threshold = SHARDS_MODULUS;
+    mrc->last_use.clear();
+    mrc->by_hash = std::priority_queue<std::pair<uint64_t, uint64_t> >();
+    mrc->live.assign(SHARDS_MIN_TIMES + 1, 0);
+    mrc->clock = 0;
+    mrc->accesses = 0;
+    mrc->references = 0;
+    mrc->cold = 0;
+    std::fill(mrc->distances, mrc->distances + 65, 0.0);
+    mrc->samples = 0;
+}
+
+double shards_rate(const shards_mrc_t *mrc) {
+    return (double) mrc->threshold / SHARDS_MODULUS;
+}
+
+void shards_access(shards_mrc_t *mrc, uint64_t addr) {
+    mrc->accesses++;
+    uint64_t block = addr >> mrc->block_bits;
+    uint64_t hash = hash_block(block) & (SHARDS_MODULUS - 1);
+    if (hash >= mrc->threshold) {
+        return;
+    }
+
+    double rate = shards_rate(mrc);
+    mrc->samples++;
+    mrc->references += 1 / rate;
+
+    if (mrc->clock + 1 == mrc->live.size()) {
+        live_compact(mrc);
+    }
+    uint64_t now = mrc->clock++;
+
+    auto it = mrc->last_use.find(block);
+    if (it != mrc->last_use.end()) {
+        /* distinct tracked blocks used since the last use of this one */
+        uint64_t sampled = live_before(mrc, now) - live_before(mrc, it->second + 1);
+        uint64_t distance = (uint64_t) (sampled / rate);
+        int bucket = distance ? 64 - __builtin_clzll(distance) : 0;
+        mrc->distances[bucket] += 1 / rate;
+
+        live_add(mrc, it->second, -1);
+        live_add(mrc, now, 1);
+        it->second = now;
+        return;
+    }
+
+    mrc->cold += 1 / rate;
+    mrc->last_use[block] = now;
+    mrc->by_hash.push(std::make_pair(hash, block));
+    live_add(mrc, now, 1);
+
+    /* over budget - stop sampling the largest hash still tracked (and any
+     * blocks sharing it) */
+    if (mrc->last_use.size() > mrc->max_blocks) {
+        mrc->threshold = mrc->by_hash.top().first;
+        while (!mrc->by_hash.empty() && mrc->by_hash.top().first >= mrc->threshold) {
+            uint64_t evicted = mrc->by_hash.top().second;
+            mrc->by_hash.pop();
+            live_add(mrc, mrc->last_use[evicted], -1);
+            mrc->last_use.erase(evicted);
+        }
+    }
+}
+
+void shards_curve(const shards_mrc_t *mrc, std::vector<mrc_point_t>& curve) {
+    curve.clear();
+    if (mrc->accesses == 0) {
+        return;
+    }
+
+    int last = 0;
+    for (int i = 0; i < 65; i++) {
+        if (mrc->distances[i] > 0) {
+            last = i;
+        }
+    }
+
+    /* a reuse hits in a cache of 2^k blocks if its distance is below 2^k,
+     * which is every bucket up to k. SHARDS_adj: the difference between the
+     * exact and the weighted reference counts goes to distance 0, so the
+     * misses start from the weighted count */
+    double total = (double) mrc->accesses;
+    double misses = total;
+    for (int k = 0; k <= last && k + mrc->block_bits < 64; k++) {
+        misses -= mrc->distances[k];
+        if (k == 0) {
+            misses -= total - mrc->references;
+        }
+        double ratio = std::min(1.0, std::max(0.0, misses / total));
+        mrc_point_t point = {(uint64_t) 1 << (k + mrc->block_bits), ratio};
+        curve.push_back(point);
+    }
+}
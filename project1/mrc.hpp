@@ -0,0 +1,59 @@
+#ifndef MRC_HPP
+#define MRC_HPP
+
+#include <stdint.h>
+#include <unordered_map>
+#include <queue>
+#include <vector>
+
+// Approximate miss ratio curves for fully associative LRU caches, using
+// fixed-size SHARDS spatial sampling (Waldspurger et al., FAST 2015). A block
+// is sampled when the hash of its address falls below a threshold, so every
+// reference to it is seen, and the reuse (stack) distances of the sampled
+// blocks scaled by the sampling rate estimate those of the whole trace. At
+// most max_blocks blocks are tracked: when another one is sampled, the
+// threshold drops to exclude the tracked block with the largest hash. Each
+// sampled reference is weighted by the inverse of the rate it was sampled at,
+// so the curve stays unbiased as the rate falls. Memory is O(max_blocks)
+// whatever the footprint of the trace.
+
+// Miss ratio of a fully associative LRU cache of size bytes
+typedef struct mrc_point {
+    uint64_t size;
+    double miss_ratio;
+} mrc_point_t;
+
+typedef struct shards_mrc {
+    int block_bits;
+    uint64_t max_blocks;
+    // Blocks whose hash is below threshold (out of SHARDS_MODULUS) are sampled
+    uint64_t threshold;
+    // Last use of each tracked block, in sampled references
+    std::unordered_map<uint64_t, uint64_t> last_use;
+    // Tracked blocks by hash, largest first, for lowering the threshold
+    std::priority_queue<std::pair<uint64_t, uint64_t> > by_hash;
+    // Fenwick tree over last-use times, counting one per tracked block
+    std::vector<int64_t> live;
+    uint64_t clock;
+    // Every reference, sampled or not
+    uint64_t accesses;
+    // Weighted sampled references: all of them, first uses, and reuses by
+    // floor(log2(scaled distance)) + 1 (0 for distance 0)
+    double references;
+    double cold;
+    double distances[65];
+    uint64_t samples;
+} shards_mrc_t;
+
+extern void shards_init(shards_mrc_t *mrc, int block_bits, uint64_t max_blocks);
+extern void shards_access(shards_mrc_t *mrc, uint64_t addr);
+// Miss ratios at every power of two size from one block up to where only
+// first-use misses are left
+extern void shards_curve(const shards_mrc_t *mrc, std::vector<mrc_point_t>& curve);
+// The current sampling rate
+extern double shards_rate(const shards_mrc_t *mrc);
+
+static const uint64_t SHARDS_MODULUS = (uint64_t) 1 << 24;
+static const uint64_t DEFAULT_SHARDS_BLOCKS = 8192;
+
+#endif /* MRC_HPP */
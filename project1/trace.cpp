@@ -0,0 +1,880 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <unordered_map>
+#include "trace.hpp"
+
+static const size_t HEADER_SIZE = 4 + 4 + 8 + 8 + 8 + 8;
+static const size_t INDEX_ENTRY_SIZE = 8 + 8 + 8;
+static const size_t L2_STREAM_HEADER_SIZE = 4 + 4 + 10 * 8;
+static const size_t L2_STREAM_FLUSH_SIZE = 1 << 16;
+
+enum l2_stream_kind {
+    L2_STREAM_READ_MISS,
+    L2_STREAM_WRITE_MISS,
+    L2_STREAM_EVICT,
+    L2_STREAM_END,
+};
+
+static void put_u32(std::vector<uint8_t>& buf, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        buf.push_back((uint8_t) (value >> (8 * i)));
+    }
+}
+
+static void put_u64(std::vector<uint8_t>& buf, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        buf.push_back((uint8_t) (value >> (8 * i)));
+    }
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static uint64_t get_u64(const uint8_t *p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static void put_varint(std::vector<uint8_t>& buf, uint64_t value) {
+    while (value >= 0x80) {
+        buf.push_back((uint8_t) (value | 0x80));
+        value >>= 7;
+    }
+    buf.push_back((uint8_t) value);
+}
+
+/* Reads a varint from [*p, end). Returns false on a truncated or overlong
+ * varint */
+static bool get_varint(const uint8_t **p, const uint8_t *end, uint64_t *value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (*p == end) {
+            return false;
+        }
+        uint8_t byte = *(*p)++;
+        result |= (uint64_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Maps signed deltas onto small unsigned values: 0, -1, 1, -2, ... */
+static uint64_t zigzag(uint64_t delta) {
+    return (delta << 1) ^ (uint64_t) ((int64_t) delta >> 63);
+}
+
+static uint64_t unzigzag(uint64_t value) {
+    return (value >> 1) ^ (0 - (value & 1));
+}
+
+static void encode_chunk(const std::vector<trace_access_t>& accesses, std::vector<uint8_t>& buf) {
+    buf.clear();
+    put_varint(buf, accesses.size());
+
+    std::vector<uint64_t> runs;
+    uint64_t run = 0;
+    bool run_write = accesses[0].rw == 'W';
+    for (size_t i = 0; i < accesses.size(); i++) {
+        bool write = accesses[i].rw == 'W';
+        if (write != run_write) {
+            runs.push_back(run);
+            run = 0;
+            run_write = write;
+        }
+        run++;
+    }
+    runs.push_back(run);
+
+    put_varint(buf, runs.size());
+    buf.push_back(accesses[0].rw == 'W');
+    for (size_t i = 0; i < runs.size(); i++) {
+        put_varint(buf, runs[i]);
+    }
+
+    uint64_t prev = 0;
+    for (size_t i = 0; i < accesses.size(); i++) {
+        put_varint(buf, zigzag(accesses[i].addr - prev));
+        prev = accesses[i].addr;
+    }
+}
+
+/* Hex digit values, -1 for anything else */
+struct hex_table {
+    int8_t digit[256];
+
+    hex_table() {
+        memset(digit, -1, sizeof digit);
+        for (int i = 0; i < 10; i++) {
+            digit['0' + i] = i;
+        }
+        for (int i = 0; i < 6; i++) {
+            digit['a' + i] = 10 + i;
+            digit['A' + i] = 10 + i;
+        }
+    }
+};
+
+static const hex_table HEX;
+
+static inline bool is_space(uint8_t c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+enum text_record {
+    TEXT_RECORD_ACCESS,
+    TEXT_RECORD_BAD,
+    TEXT_RECORD_INCOMPLETE,
+    TEXT_RECORD_END,
+};
+
+/* Decodes one record at *p the way fscanf("%c 0x%x\n") would: any character
+ * for rw, optional white space, "0x", a hex number (which may have its own
+ * sign and 0x prefix) and any trailing white space. A record that does not
+ * match ends at the first character that failed, as scanf leaves it. Running
+ * into end before the record is decided is only final at the end of input */
+static text_record parse_record(const uint8_t **next, const uint8_t *end, bool eof, trace_access_t *access) {
+    const uint8_t *p = *next;
+    text_record partial = eof ? TEXT_RECORD_BAD : TEXT_RECORD_INCOMPLETE;
+    if (p == end) {
+        return eof ? TEXT_RECORD_END : TEXT_RECORD_INCOMPLETE;
+    }
+    access->rw = *p++;
+
+    while (p < end && is_space(*p)) p++;
+    if (end - p < 2) {
+        if (eof) *next = p;
+        return partial;
+    }
+    if (p[0] != '0' || p[1] != 'x') {
+        *next = p + (p[0] == '0');
+        return TEXT_RECORD_BAD;
+    }
+    p += 2;
+
+    while (p < end && is_space(*p)) p++;
+    bool negative = p < end && *p == '-';
+    p += p < end && (*p == '-' || *p == '+');
+    if (end - p < 2 && !eof) {
+        return TEXT_RECORD_INCOMPLETE;
+    }
+    bool prefixed = end - p >= 2 && p[0] == '0' && (p[1] | 0x20) == 'x';
+    p += prefixed ? 2 : 0;
+
+    /* like strtoull, a value past 64 bits saturates, whatever the sign */
+    const uint8_t *digits = p;
+    uint64_t addr = 0;
+    bool overflow = false;
+    int8_t d;
+    while (p < end && (d = HEX.digit[*p]) >= 0) {
+        overflow |= addr >> 60 != 0;
+        addr = addr << 4 | (uint8_t) d;
+        p++;
+    }
+    if (overflow) {
+        addr = UINT64_MAX;
+        negative = false;
+    }
+    /* scanf keeps the 0 of a 0x prefix with no digits after it, so that reads as 0 */
+    if (p == digits && !prefixed) {
+        if (p < end || eof) *next = p;
+        return p < end ? TEXT_RECORD_BAD : partial;
+    }
+
+    /* the next record starts after the white space, and that may be in the next block */
+    while (p < end && is_space(*p)) p++;
+    if (p == end && !eof) {
+        return TEXT_RECORD_INCOMPLETE;
+    }
+
+    access->addr = negative ? 0 - addr : addr;
+    *next = p;
+    return TEXT_RECORD_ACCESS;
+}
+
+void text_trace_open(FILE *file, text_trace_t *trace) {
+    trace->file = file;
+    trace->map = NULL;
+    trace->map_size = 0;
+    trace->eof = false;
+
+    /* Regular files are mapped from wherever the stream is */
+    struct stat st;
+    long start = ftell(file);
+    if (!fstat(fileno(file), &st) && S_ISREG(st.st_mode) && start >= 0 && start < st.st_size) {
+        void *mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+        if (mapped != MAP_FAILED) {
+            madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+            trace->map = (const uint8_t *) mapped;
+            trace->map_size = st.st_size;
+            trace->next = trace->map + start;
+            trace->end = trace->map + st.st_size;
+            trace->eof = true;
+            return;
+        }
+    }
+
+    trace->buf.resize(TEXT_TRACE_BLOCK_SIZE);
+    trace->next = trace->end = trace->buf.data();
+}
+
+void text_trace_close(text_trace_t *trace) {
+    if (trace->map) {
+        munmap((void *) trace->map, trace->map_size);
+        trace->map = NULL;
+    }
+}
+
+/* Moves the unparsed tail to the front of the buffer and reads up to a block
+ * after it, growing the buffer if the tail fills it */
+static int text_trace_refill(text_trace_t *trace) {
+    size_t tail = trace->end - trace->next;
+    memmove(trace->buf.data(), trace->next, tail);
+    if (tail == trace->buf.size()) {
+        trace->buf.resize(2 * trace->buf.size());
+    }
+
+    size_t want = trace->buf.size() - tail;
+    size_t got = fread(trace->buf.data() + tail, 1, want, trace->file);
+    trace->next = trace->buf.data();
+    trace->end = trace->next + tail + got;
+    if (got < want) {
+        trace->eof = true;
+        if (ferror(trace->file)) {
+            printf("Could not read trace\n");
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* The usual record - rw, a space, "0x", 1 to 16 hex digits and a newline
+ * followed by the next record - decoded without bounds checks, as long as
+ * FAST_RECORD_SIZE bytes are in view. The digits are found, checked and
+ * combined 8 bytes at a time, so their varying count costs no per-digit
+ * branches. Up to 8 digits (32-bit addresses) take a single word. Returns
+ * NULL for anything else, which parse_record handles */
+static const size_t FAST_RECORD_SIZE = 4 + 16 + 2;
+static const uint64_t ONES = 0x0101010101010101ull;
+
+/* high bit set in each byte of x that is zero, exact up to the first one */
+static inline uint64_t zero_bytes(uint64_t x) {
+    return (x - ONES) & ~x & 0x80 * ONES;
+}
+
+/* high bit set in each byte of x that is strictly between lo and hi (ASCII only) */
+static inline uint64_t bytes_between(uint64_t x, uint64_t lo, uint64_t hi) {
+    uint64_t low7 = x & 0x7f * ONES;
+    return ((127 + hi) * ONES - low7) & ~x & (low7 + (127 - lo) * ONES) & 0x80 * ONES;
+}
+
+/* high bit set in each byte of x that is not a hex digit */
+static inline uint64_t non_hex_bytes(uint64_t x) {
+    uint64_t hex = bytes_between(x, '0' - 1, '9' + 1) | bytes_between(x | 0x20 * ONES, 'a' - 1, 'f' + 1);
+    return ~hex & 0x80 * ONES;
+}
+
+/* the 8 hex digits of x, first byte most significant */
+static inline uint64_t hex_value(uint64_t x) {
+    x = (x & 0x0f * ONES) + 9 * ((x >> 6) & ONES);
+    x = ((x & 0x000f000f000f000full) << 4) | ((x >> 8) & 0x000f000f000f000full);
+    x = ((x & 0x000000ff000000ffull) << 8) | ((x >> 16) & 0x000000ff000000ffull);
+    return ((x & 0xffff) << 16) | ((x >> 32) & 0xffff);
+}
+
+/* low n bytes of a word set, for n up to 8 */
+static inline uint64_t low_bytes(size_t n) {
+    return n >= 8 ? ~(uint64_t) 0 : ((uint64_t) 1 << 8 * n) - 1;
+}
+
+static inline const uint8_t *parse_common_record(const uint8_t *p, trace_access_t *access) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (p[1] != ' ' || p[2] != '0' || p[3] != 'x') {
+        return NULL;
+    }
+
+    /* there is at least one digit, so the newline is looked for after the first */
+    const uint8_t *q = p + 4;
+    uint64_t lo, after, hi;
+    memcpy(&lo, q, 8);
+    memcpy(&after, q + 1, 8);
+    uint64_t newline = zero_bytes(after ^ '\n' * ONES);
+    size_t n;
+    uint64_t addr;
+    if (newline) {
+        n = 1 + __builtin_ctzll(newline) / 8;
+        if (non_hex_bytes(lo) & low_bytes(n)) {
+            return NULL;
+        }
+        addr = hex_value(lo) >> 4 * (8 - n);
+    }
+    else {
+        memcpy(&hi, q + 8, 8);
+        memcpy(&after, q + 9, 8);
+        newline = zero_bytes(after ^ '\n' * ONES);
+        if (!newline) {
+            return NULL;
+        }
+        n = 9 + __builtin_ctzll(newline) / 8;
+        if (non_hex_bytes(lo) | (non_hex_bytes(hi) & low_bytes(n - 8))) {
+            return NULL;
+        }
+        addr = (hex_value(lo) << 32 | hex_value(hi)) >> 4 * (16 - n);
+    }
+    if (is_space(q[n + 1])) {
+        return NULL;
+    }
+
+    access->rw = p[0];
+    access->addr = addr;
+    return q + n + 1;
+#else
+    return NULL;
+#endif
+}
+
+int text_trace_read(text_trace_t *trace, std::vector<trace_access_t>& out, size_t max) {
+    size_t size = out.size();
+    out.resize(size + max);
+    trace_access_t *dst = out.data() + size;
+    trace_access_t *dst_end = dst + max;
+    int ret = 0;
+    while (dst < dst_end) {
+        /* the usual records, with the cursor kept out of memory */
+        const uint8_t *next = trace->next;
+        const uint8_t *fast_end = trace->end - std::min<size_t>(trace->end - next, FAST_RECORD_SIZE);
+        const uint8_t *after;
+        while (dst < dst_end && next < fast_end && (after = parse_common_record(next, dst))) {
+            next = after;
+            dst++;
+        }
+        trace->next = next;
+        if (dst == dst_end) {
+            break;
+        }
+
+        text_record record = parse_record(&trace->next, trace->end, trace->eof, dst);
+        if (record == TEXT_RECORD_ACCESS) {
+            dst++;
+        }
+        else if (record == TEXT_RECORD_INCOMPLETE && text_trace_refill(trace)) {
+            ret = 1;
+            break;
+        }
+        else if (record == TEXT_RECORD_END) {
+            break;
+        }
+    }
+    out.resize(dst - out.data());
+    return ret;
+}
+
+bool trace_is_packed(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    char magic[sizeof TRACE_MAGIC];
+    bool packed = fread(magic, 1, sizeof magic, file) == sizeof magic
+                  && !memcmp(magic, TRACE_MAGIC, sizeof magic);
+    fclose(file);
+    return packed;
+}
+
+static void build_header(std::vector<uint8_t>& buf, uint64_t chunk_size, uint64_t num_accesses,
+                         uint64_t num_chunks, uint64_t index_offset) {
+    buf.clear();
+    buf.insert(buf.end(), TRACE_MAGIC, TRACE_MAGIC + sizeof TRACE_MAGIC);
+    put_u32(buf, TRACE_VERSION);
+    put_u64(buf, chunk_size);
+    put_u64(buf, num_accesses);
+    put_u64(buf, num_chunks);
+    put_u64(buf, index_offset);
+}
+
+int trace_pack(FILE *text, FILE *out, uint64_t chunk_size, uint64_t *num_accesses) {
+    std::vector<uint8_t> buf;
+    std::vector<trace_access_t> accesses;
+    std::vector<trace_chunk_t> chunks;
+    uint64_t offset = HEADER_SIZE;
+    uint64_t total = 0;
+
+    /* Reserve the header, it is rewritten once the index offset is known */
+    build_header(buf, chunk_size, 0, 0, 0);
+    if (fwrite(buf.data(), 1, buf.size(), out) != buf.size()) {
+        printf("Could not write packed trace\n");
+        return 1;
+    }
+
+    text_trace_t trace;
+    text_trace_open(text, &trace);
+    bool done = false;
+    while (!done) {
+        if (text_trace_read(&trace, accesses, chunk_size)) {
+            text_trace_close(&trace);
+            return 1;
+        }
+        done = accesses.size() < chunk_size;
+        if (!accesses.empty()) {
+            encode_chunk(accesses, buf);
+            if (fwrite(buf.data(), 1, buf.size(), out) != buf.size()) {
+                printf("Could not write packed trace\n");
+                text_trace_close(&trace);
+                return 1;
+            }
+            trace_chunk_t chunk = {offset, buf.size(), accesses.size()};
+            chunks.push_back(chunk);
+            offset += buf.size();
+            total += accesses.size();
+            accesses.clear();
+        }
+    }
+    text_trace_close(&trace);
+
+    buf.clear();
+    for (size_t i = 0; i < chunks.size(); i++) {
+        put_u64(buf, chunks[i].offset);
+        put_u64(buf, chunks[i].length);
+        put_u64(buf, chunks[i].count);
+    }
+    if (fwrite(buf.data(), 1, buf.size(), out) != buf.size()) {
+        printf("Could not write packed trace\n");
+        return 1;
+    }
+
+    build_header(buf, chunk_size, total, chunks.size(), offset);
+    if (fseek(out, 0, SEEK_SET) || fwrite(buf.data(), 1, buf.size(), out) != buf.size()
+        || fflush(out)) {
+        printf("Could not write packed trace header (is the output seekable?)\n");
+        return 1;
+    }
+
+    *num_accesses = total;
+    return 0;
+}
+
+/* Maps the whole file at path read-only. Returns nonzero on failure */
+static int map_file(const char *path, const uint8_t **data, size_t *size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("Could not open `%s'\n", path);
+        return 1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size == 0) {
+        printf("`%s' is empty\n", path);
+        close(fd);
+        return 1;
+    }
+
+    void *mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        printf("Could not map `%s'\n", path);
+        return 1;
+    }
+
+    *data = (const uint8_t *) mapped;
+    *size = st.st_size;
+    return 0;
+}
+
+int trace_open_packed(const char *path, packed_trace_t *trace) {
+    if (map_file(path, &trace->data, &trace->size)) {
+        return 1;
+    }
+
+    if (trace->size < HEADER_SIZE) {
+        printf("Packed trace `%s' is truncated\n", path);
+        trace_close_packed(trace);
+        return 1;
+    }
+
+    trace->chunks.clear();
+
+    const uint8_t *p = trace->data;
+    uint64_t num_chunks = get_u64(p + 24);
+    uint64_t index_offset = get_u64(p + 32);
+    trace->chunk_size = get_u64(p + 8);
+    trace->num_accesses = get_u64(p + 16);
+
+    if (memcmp(p, TRACE_MAGIC, sizeof TRACE_MAGIC) || get_u32(p + 4) != TRACE_VERSION) {
+        printf("`%s' is not a version %" PRIu32 " packed trace\n", path, TRACE_VERSION);
+        trace_close_packed(trace);
+        return 1;
+    }
+
+    if (index_offset > trace->size
+        || num_chunks > (trace->size - index_offset) / INDEX_ENTRY_SIZE) {
+        printf("Packed trace `%s' has a corrupt index\n", path);
+        trace_close_packed(trace);
+        return 1;
+    }
+
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < num_chunks; i++) {
+        const uint8_t *entry = p + index_offset + i * INDEX_ENTRY_SIZE;
+        trace_chunk_t chunk = {get_u64(entry), get_u64(entry + 8), get_u64(entry + 16)};
+        if (chunk.offset > index_offset || chunk.length > index_offset - chunk.offset
+            || chunk.count > trace->chunk_size) {
+            printf("Packed trace `%s' has a corrupt index\n", path);
+            trace_close_packed(trace);
+            return 1;
+        }
+        trace->chunks.push_back(chunk);
+        total += chunk.count;
+    }
+
+    if (total != trace->num_accesses) {
+        printf("Packed trace `%s' has a corrupt index\n", path);
+        trace_close_packed(trace);
+        return 1;
+    }
+
+    return 0;
+}
+
+void trace_close_packed(packed_trace_t *trace) {
+    if (trace->data) {
+        munmap((void *) trace->data, trace->size);
+    }
+    trace->data = NULL;
+    trace->size = 0;
+    trace->chunks.clear();
+}
+
+bool trace_decode_chunk(const packed_trace_t *trace, uint64_t chunk, std::vector<trace_access_t>& out) {
+    const trace_chunk_t *info = &trace->chunks[chunk];
+    const uint8_t *p = trace->data + info->offset;
+    const uint8_t *end = p + info->length;
+    uint64_t count, num_runs;
+
+    out.clear();
+    if (!get_varint(&p, end, &count) || count != info->count
+        || !get_varint(&p, end, &num_runs) || p == end) {
+        return false;
+    }
+
+    out.resize(count);
+    char rw = *p++ ? 'W' : 'R';
+    uint64_t filled = 0;
+    for (uint64_t i = 0; i < num_runs; i++) {
+        uint64_t run;
+        if (!get_varint(&p, end, &run) || run > count - filled) {
+            return false;
+        }
+        for (uint64_t j = 0; j < run; j++) {
+            out[filled++].rw = rw;
+        }
+        rw = rw == 'W' ? 'R' : 'W';
+    }
+    if (filled != count) {
+        return false;
+    }
+
+    uint64_t addr = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t delta;
+        if (!get_varint(&p, end, &delta)) {
+            return false;
+        }
+        addr += unzigzag(delta);
+        out[i].addr = addr;
+    }
+
+    return p == end;
+}
+
+/* one pass from the end of the trace, remembering where each block is accessed next */
+void trace_next_uses(const std::vector<trace_access_t>& accesses, uint64_t block_bits,
+                     std::vector<uint64_t>& next_uses) {
+    std::unordered_map<uint64_t, uint64_t> next_access;
+    next_uses.resize(accesses.size());
+    for (size_t i = accesses.size(); i-- > 0;) {
+        uint64_t block = accesses[i].addr >> block_bits;
+        std::unordered_map<uint64_t, uint64_t>::iterator it = next_access.find(block);
+        if (it == next_access.end()) {
+            next_uses[i] = NO_NEXT_USE;
+            next_access[block] = i;
+        }
+        else {
+            next_uses[i] = it->second;
+            it->second = i;
+        }
+    }
+}
+
+static int l2_stream_flush(l2_stream_writer_t *writer) {
+    if (fwrite(writer->buf.data(), 1, writer->buf.size(), writer->file) != writer->buf.size()) {
+        return 1;
+    }
+    writer->buf.clear();
+    return 0;
+}
+
+static void build_l2_stream_header(std::vector<uint8_t>& buf, const cache_config_t *l1,
+                                   uint64_t victim_cache_entries, uint64_t events, uint64_t stats_offset) {
+    buf.insert(buf.end(), L2_STREAM_MAGIC, L2_STREAM_MAGIC + sizeof L2_STREAM_MAGIC);
+    put_u32(buf, L2_STREAM_VERSION);
+    put_u64(buf, l1->c);
+    put_u64(buf, l1->b);
+    put_u64(buf, l1->s);
+    put_u64(buf, l1->sector_b);
+    put_u64(buf, l1->insert_policy);
+    put_u64(buf, l1->index_func);
+    put_u64(buf, l1->way_prediction);
+    put_u64(buf, victim_cache_entries);
+    put_u64(buf, events);
+    put_u64(buf, stats_offset);
+}
+
+int l2_stream_create(const char *path, const sim_config_t *config, l2_stream_writer_t *writer) {
+    writer->file = fopen(path, "wb");
+    if (!writer->file) {
+        printf("Could not open `%s' for writing\n", path);
+        return 1;
+    }
+
+    writer->buf.clear();
+    writer->l1_config = config->l1_config;
+    writer->victim_cache_entries = config->victim_cache_entries;
+    writer->events = 0;
+    writer->last_access = 0;
+    writer->last_miss = 0;
+    writer->last_evict = 0;
+
+    /* Rewritten with the event count and stats offset once they are known */
+    build_l2_stream_header(writer->buf, &config->l1_config, config->victim_cache_entries, 0, 0);
+    return 0;
+}
+
+void l2_stream_write(const l2_event_t *event, void *arg) {
+    l2_stream_writer_t *writer = (l2_stream_writer_t *) arg;
+    std::vector<uint8_t>& buf = writer->buf;
+    uint64_t delta = event->access - writer->last_access;
+    writer->last_access = event->access;
+    writer->events++;
+
+    if (event->type == L2_EVENT_MISS) {
+        put_varint(buf, delta << 2 | (event->rw == 'W' ? L2_STREAM_WRITE_MISS : L2_STREAM_READ_MISS));
+        put_varint(buf, zigzag(event->addr - writer->last_miss));
+        writer->last_miss = event->addr;
+    }
+    else {
+        put_varint(buf, delta << 2 | L2_STREAM_EVICT);
+        put_varint(buf, zigzag(event->addr - writer->last_evict));
+        put_varint(buf, event->valid);
+        put_varint(buf, event->dirty);
+        writer->last_evict = event->addr;
+    }
+
+    /* Write errors are picked up by l2_stream_finish */
+    if (buf.size() >= L2_STREAM_FLUSH_SIZE) {
+        l2_stream_flush(writer);
+    }
+}
+
+int l2_stream_finish(l2_stream_writer_t *writer, const sim_stats_t *stats) {
+    std::vector<uint8_t>& buf = writer->buf;
+    put_varint(buf, L2_STREAM_END);
+    int failed = l2_stream_flush(writer);
+    long stats_offset = ftell(writer->file);
+
+    put_u64(buf, stats->accesses_l1);
+    put_u64(buf, stats->hits_l1);
+    put_u64(buf, stats->misses_l1);
+    put_u64(buf, stats->hits_victim_cache);
+    put_u64(buf, stats->misses_victim_cache);
+    put_u64(buf, stats->reads);
+    put_u64(buf, stats->writes);
+    put_u64(buf, stats->bytes_l1_to_victim_cache);
+    put_u64(buf, stats->bytes_victim_cache_to_l1);
+    put_u64(buf, stats->num_sets_l1);
+    for (uint64_t i = 0; i < stats->num_sets_l1; i++) {
+        const set_stats_t *set = &stats->set_stats_l1[i];
+        put_varint(buf, set->accesses);
+        put_varint(buf, set->misses);
+        put_varint(buf, set->evictions);
+        for (int j = 0; j < SET_STATS_TOP_BLOCKS; j++) {
+            put_varint(buf, set->top_blocks[j].count);
+            if (set->top_blocks[j].count) {
+                put_varint(buf, set->top_blocks[j].addr);
+            }
+        }
+    }
+
+    /* latencies of the accesses served on the L1 side */
+    uint64_t buckets = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        buckets += stats->latency_histogram[i] != 0;
+    }
+    put_varint(buf, stats->latency_total);
+    put_varint(buf, stats->latency_max);
+    put_varint(buf, buckets);
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        if (stats->latency_histogram[i]) {
+            put_varint(buf, i);
+            put_varint(buf, stats->latency_histogram[i]);
+        }
+    }
+    put_varint(buf, stats->way_predicted_hits_l1);
+    failed |= l2_stream_flush(writer);
+
+    build_l2_stream_header(buf, &writer->l1_config, writer->victim_cache_entries,
+                           writer->events, stats_offset);
+    failed |= fseek(writer->file, 0, SEEK_SET) || l2_stream_flush(writer);
+    failed |= fclose(writer->file) != 0;
+    writer->file = NULL;
+
+    if (failed) {
+        printf("Could not write L2 request stream\n");
+    }
+    return failed;
+}
+
+int l2_stream_open(const char *path, l2_stream_t *stream) {
+    if (map_file(path, &stream->data, &stream->size)) {
+        return 1;
+    }
+
+    const uint8_t *p = stream->data;
+    if (stream->size < L2_STREAM_HEADER_SIZE || memcmp(p, L2_STREAM_MAGIC, sizeof L2_STREAM_MAGIC)
+        || get_u32(p + 4) != L2_STREAM_VERSION) {
+        printf("`%s' is not a version %" PRIu32 " L2 request stream\n", path, L2_STREAM_VERSION);
+        l2_stream_close(stream);
+        return 1;
+    }
+
+    stream->l1_config = DEFAULT_SIM_CONFIG.l1_config;
+    stream->l1_config.c = get_u64(p + 8);
+    stream->l1_config.b = get_u64(p + 16);
+    stream->l1_config.s = get_u64(p + 24);
+    stream->l1_config.sector_b = get_u64(p + 32);
+    stream->l1_config.insert_policy = (insert_policy_t) get_u64(p + 40);
+    stream->l1_config.index_func = (index_func_t) get_u64(p + 48);
+    stream->l1_config.way_prediction = get_u64(p + 56);
+    stream->victim_cache_entries = get_u64(p + 64);
+    stream->events = get_u64(p + 72);
+    uint64_t stats_offset = get_u64(p + 80);
+
+    memset(&stream->stats, 0, sizeof stream->stats);
+    const uint8_t *end = stream->data + stream->size;
+    bool ok = stats_offset >= L2_STREAM_HEADER_SIZE && stats_offset <= stream->size
+              && stream->size - stats_offset >= 10 * 8;
+    if (ok) {
+        const uint8_t *q = stream->data + stats_offset;
+        stream->stats.accesses_l1 = get_u64(q);
+        stream->stats.hits_l1 = get_u64(q + 8);
+        stream->stats.misses_l1 = get_u64(q + 16);
+        stream->stats.hits_victim_cache = get_u64(q + 24);
+        stream->stats.misses_victim_cache = get_u64(q + 32);
+        stream->stats.reads = get_u64(q + 40);
+        stream->stats.writes = get_u64(q + 48);
+        stream->stats.bytes_l1_to_victim_cache = get_u64(q + 56);
+        stream->stats.bytes_victim_cache_to_l1 = get_u64(q + 64);
+        uint64_t num_sets = get_u64(q + 72);
+        q += 10 * 8;
+
+        /* every set takes at least a byte per counter */
+        ok = num_sets <= (uint64_t) (end - q) / (3 + SET_STATS_TOP_BLOCKS);
+        stream->set_stats_l1.assign(ok ? num_sets : 0, set_stats_t());
+        for (uint64_t i = 0; ok && i < num_sets; i++) {
+            set_stats_t *set = &stream->set_stats_l1[i];
+            ok = get_varint(&q, end, &set->accesses) && get_varint(&q, end, &set->misses)
+                 && get_varint(&q, end, &set->evictions);
+            for (int j = 0; ok && j < SET_STATS_TOP_BLOCKS; j++) {
+                ok = get_varint(&q, end, &set->top_blocks[j].count)
+                     && (!set->top_blocks[j].count || get_varint(&q, end, &set->top_blocks[j].addr));
+            }
+        }
+
+        uint64_t buckets = 0;
+        ok = ok && get_varint(&q, end, &stream->stats.latency_total)
+             && get_varint(&q, end, &stream->stats.latency_max) && get_varint(&q, end, &buckets);
+        for (uint64_t i = 0; ok && i < buckets; i++) {
+            uint64_t bucket, count;
+            ok = get_varint(&q, end, &bucket) && get_varint(&q, end, &count)
+                 && bucket < (uint64_t) LATENCY_BUCKETS;
+            if (ok) {
+                stream->stats.latency_histogram[bucket] = count;
+            }
+        }
+        ok = ok && get_varint(&q, end, &stream->stats.way_predicted_hits_l1);
+    }
+
+    if (!ok) {
+        printf("L2 request stream `%s' is truncated\n", path);
+        l2_stream_close(stream);
+        return 1;
+    }
+
+    stream->stats.num_sets_l1 = stream->set_stats_l1.size();
+    stream->stats.set_stats_l1 = stream->set_stats_l1.data();
+    stream->next = stream->data + L2_STREAM_HEADER_SIZE;
+    stream->end = stream->data + stats_offset;
+    stream->last_access = 0;
+    stream->last_miss = 0;
+    stream->last_evict = 0;
+    return 0;
+}
+
+void l2_stream_close(l2_stream_t *stream) {
+    if (stream->data) {
+        munmap((void *) stream->data, stream->size);
+    }
+    stream->data = NULL;
+    stream->size = 0;
+}
+
+int l2_stream_next(l2_stream_t *stream, l2_event_t *event) {
+    uint64_t head, delta;
+    if (!get_varint(&stream->next, stream->end, &head)) {
+        return -1;
+    }
+
+    uint64_t kind = head & 3;
+    if (kind == L2_STREAM_END) {
+        return 0;
+    }
+
+    stream->last_access += head >> 2;
+    event->access = stream->last_access;
+    if (!get_varint(&stream->next, stream->end, &delta)) {
+        return -1;
+    }
+
+    if (kind != L2_STREAM_EVICT) {
+        event->type = L2_EVENT_MISS;
+        event->rw = kind == L2_STREAM_WRITE_MISS ? 'W' : 'R';
+        event->addr = stream->last_miss += unzigzag(delta);
+        event->valid = 0;
+        event->dirty = 0;
+        return 1;
+    }
+
+    event->type = L2_EVENT_EVICT;
+    event->rw = 0;
+    event->addr = stream->last_evict += unzigzag(delta);
+    if (!get_varint(&stream->next, stream->end, &event->valid)
+        || !get_varint(&stream->next, stream->end, &event->dirty)) {
+        return -1;
+    }
+    return 1;
+}
@@ -0,0 +1,161 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "cachesim.hpp"
+
+// Packed traces store the accesses of a text trace in independently encoded
+// chunks, followed by an index of the chunks, so chunks can be decoded in
+// parallel and a run can start at any access. Within a chunk the rw flags are
+// run-length encoded, and each address is the zigzag varint of its
+// difference from the previous address in the chunk (the first is relative
+// to 0). All integers in the file are little endian.
+//
+// Layout:
+//   header:  "CTRZ", u32 version, u64 chunk size, u64 accesses, u64 chunks,
+//            u64 index offset
+//   chunks:  varint count, varint runs, u8 first rw (0 = R, 1 = W),
+//            varint run lengths (alternating rw), zigzag varint deltas
+//   index:   per chunk u64 offset, u64 length in bytes, u64 count
+
+// One trace event, as passed to sim_access
+typedef struct trace_access {
+    uint64_t addr;
+    char rw;
+} trace_access_t;
+
+// Where one chunk of a packed trace lives
+typedef struct trace_chunk {
+    uint64_t offset;
+    uint64_t length;
+    uint64_t count;
+} trace_chunk_t;
+
+// A packed trace mapped into memory
+typedef struct packed_trace {
+    const uint8_t *data;
+    size_t size;
+    // Accesses per chunk. Only the last chunk may hold fewer
+    uint64_t chunk_size;
+    uint64_t num_accesses;
+    std::vector<trace_chunk_t> chunks;
+} packed_trace_t;
+
+// Reads text traces (a "R 0x1f40" or "W 0x1f40" record per line) without
+// going through scanf, though records parse exactly as with
+// fscanf("%c 0x%" PRIx64 "\n"). Regular files are mapped; pipes are read
+// in TEXT_TRACE_BLOCK_SIZE blocks, and a record cut off at the end of a block
+// is parsed again once the next one is in. Records that do not match are
+// skipped
+typedef struct text_trace {
+    FILE *file;
+    const uint8_t *map;
+    size_t map_size;
+    std::vector<uint8_t> buf;
+    const uint8_t *next;
+    const uint8_t *end;
+    bool eof;
+} text_trace_t;
+
+extern void text_trace_open(FILE *file, text_trace_t *trace);
+extern void text_trace_close(text_trace_t *trace);
+// Decodes up to max more accesses, appending them to out. Fewer means the
+// trace has ended. Returns nonzero on a read error
+extern int text_trace_read(text_trace_t *trace, std::vector<trace_access_t>& out, size_t max);
+
+// Returns true if the file at path starts with the packed trace magic
+extern bool trace_is_packed(const char *path);
+
+// Encodes the text trace read from text into a packed trace written to out,
+// which must be seekable. Returns nonzero on failure
+extern int trace_pack(FILE *text, FILE *out, uint64_t chunk_size, uint64_t *num_accesses);
+
+// Maps and validates a packed trace. Returns nonzero on failure
+extern int trace_open_packed(const char *path, packed_trace_t *trace);
+extern void trace_close_packed(packed_trace_t *trace);
+
+// Decodes one chunk into out (replacing its contents). Safe to call from
+// several threads at once. Returns false if the chunk is corrupt
+extern bool trace_decode_chunk(const packed_trace_t *trace, uint64_t chunk, std::vector<trace_access_t>& out);
+
+// Fills next_uses[i] with the index of the next access after accesses[i] to
+// the same 2^block_bits byte block, or NO_NEXT_USE, as sim_access_opt takes
+extern void trace_next_uses(const std::vector<trace_access_t>& accesses, uint64_t block_bits,
+                            std::vector<uint64_t>& next_uses);
+
+// L2 request streams hold the requests the L1 side of a run sent to the L2
+// (see sim_set_l2_hook), so L2 configurations can be swept without
+// simulating L1 and the victim cache again. Each event starts with a varint
+// holding its access count delta from the previous event shifted left by 2,
+// and the kind in the low bits (read miss, write miss, eviction, end).
+// Misses continue with the zigzag address delta from the previous miss.
+// Evictions continue with the zigzag block address delta from the previous
+// eviction and the valid and dirty sector masks. The L1 side stats follow
+// the end event.
+//
+// Layout:
+//   header:  "CL2S", u32 version, u64 L1 c, b, s, sector_b, insert policy,
+//            index function, way prediction, u64 victim cache entries,
+//            u64 events, u64 stats offset
+//   events:  as above
+//   stats:   u64 accesses_l1, hits_l1, misses_l1, hits_victim_cache,
+//            misses_victim_cache, reads, writes, bytes_l1_to_victim_cache,
+//            bytes_victim_cache_to_l1, num_sets_l1, then per L1
+//            set varint accesses, misses, evictions and top block counts,
+//            each nonzero count followed by its block address, then varint
+//            latency_total, latency_max, the number of nonzero latency
+//            buckets and each one's varint index and count, then varint
+//            way_predicted_hits_l1
+
+typedef struct l2_stream_writer {
+    FILE *file;
+    std::vector<uint8_t> buf;
+    cache_config_t l1_config;
+    uint64_t victim_cache_entries;
+    uint64_t events;
+    uint64_t last_access, last_miss, last_evict;
+} l2_stream_writer_t;
+
+// A recorded stream mapped into memory, with a cursor over its events
+typedef struct l2_stream {
+    const uint8_t *data;
+    size_t size;
+    const uint8_t *next;
+    const uint8_t *end;
+    uint64_t events;
+    uint64_t last_access, last_miss, last_evict;
+    // The L1 and victim cache configuration the stream was recorded with
+    cache_config_t l1_config;
+    uint64_t victim_cache_entries;
+    // L1 side counters of the recording run
+    sim_stats_t stats;
+    std::vector<set_stats_t> set_stats_l1;
+} l2_stream_t;
+
+// Starts recording the requests of an L1 side configured as in config.
+// Returns nonzero on failure
+extern int l2_stream_create(const char *path, const sim_config_t *config, l2_stream_writer_t *writer);
+// An l2_hook_t, arg is the writer
+extern void l2_stream_write(const l2_event_t *event, void *arg);
+// Appends the L1 side stats (after sim_finish) and closes the file
+extern int l2_stream_finish(l2_stream_writer_t *writer, const sim_stats_t *stats);
+
+// Maps a recorded stream and reads its configuration and stats. Returns
+// nonzero on failure
+extern int l2_stream_open(const char *path, l2_stream_t *stream);
+extern void l2_stream_close(l2_stream_t *stream);
+// Decodes the next event. Returns 1 for an event, 0 at the end and -1 if the
+// stream is corrupt
+extern int l2_stream_next(l2_stream_t *stream, l2_event_t *event);
+
+static const char TRACE_MAGIC[4] = {'C', 'T', 'R', 'Z'};
+static const uint32_t TRACE_VERSION = 1;
+static const uint64_t DEFAULT_TRACE_CHUNK_SIZE = 1 << 16;
+static const size_t TEXT_TRACE_BLOCK_SIZE = 1 << 20;
+static const char L2_STREAM_MAGIC[4] = {'C', 'L', '2', 'S'};
+static const uint32_t L2_STREAM_VERSION = 5;
+
+#endif /* TRACE_HPP */
@@ -63,7 +63,22 @@ generate_stats_and_diff() {
     fi
 }
 
+# How far the default configuration is from Belady's OPT on each benchmark
+print_opt_headroom() {
+    banner "OPT headroom of the default configuration..."
+    for benchmark in "${default_benchmarks[@]}"; do
+        printf '==> %s\n' "$benchmark"
+        ./run.sh -O <"traces/$benchmark.trace" | sed -n '/^OPT Headroom$/,$p' | tail -n +4
+        printf '\n'
+    done
+}
+
 main() {
+    if [[ $1 == --opt-headroom ]]; then
+        print_opt_headroom
+        return
+    fi
+
     mkdir -p "$student_stat_dir"
 
     banner "Testing only L1 cache..."
@@ -81,4 +96,4 @@ main() {
     done
 }
 
-main
+main "$@"
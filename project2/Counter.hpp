@@ -3,37 +3,45 @@
 
 #include <cstdint>
 #include <math.h>
+#include <vector>
+
+/* class CounterTable definition: a table of saturating counters of the same width, packed one byte
+ * per counter into a contiguous array. The accessors are defined here so the predictors can inline
+ * them in their lookup loops */
+class CounterTable {
 
-/* class Counter definition */
-class Counter {
-  
     private:
-      uint64_t width, val, max, weakly_taken;
+      std::vector<uint8_t> vals;
+      uint8_t max, weakly_taken;
+
+    public:
+      CounterTable() : max(0), weakly_taken(0) {}
 
-    public:      
-      /* Initializes a counter of width-bits to weakly taken */
-      Counter(uint64_t _width);
+      /* Initializes size counters of width-bits (at most 8) to weakly taken */
+      CounterTable(uint64_t size, uint64_t width);
 
-      /* Initializes a counter of width-bits to specified value */
-      Counter(uint64_t _width, int _val);
-      
-      /* Transitions in the Saturating Counter state diagram according to this branch being taken or not taken */
-      void update(bool taken);
+      /* Initializes size counters of width-bits (at most 8) to specified value */
+      CounterTable(uint64_t size, uint64_t width, int val);
 
-      /* Returns current counter value */
-      uint64_t get();
+      /* Transitions counter i in the Saturating Counter state diagram, without branching on the outcome */
+      void update(uint64_t i, bool taken) {
+          uint8_t val = vals[i];
+          val += taken & (val < max);
+          val -= !taken & (val > 0);
+          vals[i] = val;
+      }
 
-      /* Returns true if the current counter is weakly taken or greater */
-      bool isTaken();
+      /* Returns current value of counter i */
+      uint64_t get(uint64_t i) const { return vals[i]; }
 
-      /* Sets counter value */
-      void setCount(uint64_t count);
+      /* Returns true if counter i is weakly taken or greater */
+      bool isTaken(uint64_t i) const { return vals[i] >= weakly_taken; }
 
-      /* Returns true if the current counter is in the weakly taken or weakly not-taken states */
-      bool isWeak();
+      /* Returns true if counter i is in the weakly taken or weakly not-taken states */
+      bool isWeak(uint64_t i) const { return (uint8_t) (vals[i] - (weakly_taken - 1)) <= 1; }
 
-      /* Sets counter to either weakly taken (if taken==true) or weakly not taken (if taken==false) -- used in TAGE-S */
-      void reset(bool taken);
+      /* Sets counter i to either weakly taken (if taken==true) or weakly not taken (if taken==false) */
+      void reset(uint64_t i, bool taken) { vals[i] = weakly_taken - !taken; }
 };
 
 #endif
@@ -14,33 +14,35 @@
 //
 // =====================================================================
 
-TAGE_GHR::TAGE_GHR() {}
+TAGE_GHR::TAGE_GHR() : head(0), ringMask(0), recent(0), length(0) {}
 
-TAGE_GHR::TAGE_GHR(uint64_t len) : historyChunks(std::vector<uint64_t>(calcNumChunks(len), 0)), length(len) {}
-
-size_t TAGE_GHR::calcNumChunks(uint64_t len) {
-    // Round len up to a factor of 64
-    if (len & ~((uint64_t)-1 << 6)) {
-        len = (len & (-1 << 6)) + (1 << 6);
+TAGE_GHR::TAGE_GHR(uint64_t len) : head(0), recent(0), length(len) {
+    // Round the ring up to a power of two, so wrapping is a mask
+    size_t size = 1;
+    while (size < len) {
+        size <<= 1;
     }
-    // Divide by 64
-    return len >> 6;
+    ring.assign(size, 0);
+    ringMask = size - 1;
 }
 
 void TAGE_GHR::shiftLeft(bool taken) {
-    for (size_t i = 0; i < historyChunks.size(); i++) {
-        unsigned char next_bit;
-        if (i+1 < historyChunks.size()) {
-            next_bit = historyChunks[i+1] >> 63;
-        } else {
-            next_bit = taken;
-        }
-        historyChunks[i] = (historyChunks[i] << 1) | next_bit;
+    // Rotate each compressed history by one within its width, then fold the
+    // new bit in and the bit leaving the history out. Every history bit moves
+    // up one position, so this is all that changes
+    for (FoldedHistory &f : folded) {
+        uint64_t out = ring[(head + f.length - 1) & ringMask];
+        uint64_t value = ((f.value << 1) & f.mask) | (f.value >> (f.width - 1));
+        f.value = value ^ taken ^ (out << f.outPosition);
     }
+
+    head = (head - 1) & ringMask;
+    ring[head] = taken;
+    recent = (recent << 1) | taken;
 }
 
 uint64_t TAGE_GHR::getHistory() {
-    uint64_t history = historyChunks[historyChunks.size()-1];
+    uint64_t history = recent;
     if (length < 64) {
         history = history & ~((uint64_t)-1 << length);
     }
@@ -49,45 +51,23 @@ uint64_t TAGE_GHR::getHistory() {
 }
 
 uint64_t TAGE_GHR::getCompressedHistory(uint64_t length, uint64_t width) {
+    // Bit i of the history lands on bit i % width of the result
     uint64_t base = 0;
-    size_t rhs = 0;
-
-    while (rhs < length) {
-        // Need to extract width bits from array of 64-bit uints
-        // Round down to a multiple of 64
-        size_t rightChunkIdx = rhs >> 6;
-        size_t rightChunkOffset = rhs & ~((uint64_t)-1 << 6);
-        uint64_t rightChunk = historyChunks[historyChunks.size()-1 - rightChunkIdx];
-        rightChunk = rightChunk >> rightChunkOffset;
-        size_t rightBits = std::min(width, 64-rightChunkOffset);
-        rightChunk = rightChunk & ~((uint64_t)-1 << rightBits);
-        uint64_t piece = rightChunk;
-
-        // Need a left chunk too
-        if (width > 64-rightChunkOffset) {
-            uint64_t leftChunk;
-            if (rightChunkIdx + 1 >= historyChunks.size()) {
-                // Edge case: if we are overflowing the history chunks array,
-                // just use NT
-                leftChunk = 0;
-            } else {
-                leftChunk = historyChunks[historyChunks.size()-1 - (rightChunkIdx+1)];
-                size_t leftBits = width - rightBits;
-                leftChunk = leftChunk & ~((uint64_t)-1 << leftBits);
-            }
-            piece = piece | (leftChunk << rightBits);
-        }
-
-        if (rhs + width > length) {
-            // Need to be very careful here: we shouldn't use bits that go past
-            // the requested history length. We can't let the students see the truth!!!
-            piece = piece & ~((uint64_t)-1 << (length - rhs));
-        }
-
-        base = base ^ piece;
-
-        rhs += width;
+    for (uint64_t i = 0; i < length; i++) {
+        base ^= (uint64_t) ring[(head + i) & ringMask] << (i % width);
     }
 
     return base;
 }
+
+size_t TAGE_GHR::addFoldedHistory(uint64_t length, uint64_t width) {
+    FoldedHistory f;
+    f.length = length;
+    f.width = width;
+    f.outPosition = length % width;
+    f.mask = width < 64 ? ~((uint64_t)-1 << width) : (uint64_t)-1;
+    f.value = getCompressedHistory(length, width);
+    folded.push_back(f);
+
+    return folded.size() - 1;
+}
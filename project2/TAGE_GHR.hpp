@@ -10,21 +10,37 @@
 /**
  * This class helps track global history and calculate compressed history for
  * TAGE. We have implemented it fully for you in TAGE_GHR.cpp! Internally, it
- * maintains a large GHR of arbitrary length which you can update for each
- * branch with shiftLeft(). You can query up to the last 64 bits of the full
- * history with getHistory(). Or you can call getCompressedHistory() to
- * generate compressed history of arbitrary widths as if that compressed
- * history was derived from a shorter history than the longer history actually
- * stored in this class.
+ * maintains a large GHR of arbitrary length, in a ring buffer with a head
+ * pointer, which you can update for each branch with shiftLeft(). You can
+ * query up to the last 64 bits of the full history with getHistory(). Or you
+ * can call getCompressedHistory() to generate compressed history of arbitrary
+ * widths as if that compressed history was derived from a shorter history
+ * than the longer history actually stored in this class, or register such a
+ * compressed history with addFoldedHistory() to have shiftLeft() maintain it.
  */
 class TAGE_GHR {
 
 private:
 
-    std::vector<uint64_t> historyChunks;
+    // Raw history, one bit per byte in a ring: bit i of the history (bit 0 is
+    // the most recent outcome) lives at ring[(head + i) & ringMask]
+    std::vector<uint8_t> ring;
+    size_t head;
+    size_t ringMask;
+    // The most recent 64 bits of history, for getHistory()
+    uint64_t recent;
     uint64_t length;
 
-static size_t calcNumChunks(uint64_t);
+    // A compressed history kept up to date by shiftLeft(), one per
+    // addFoldedHistory() call
+    struct FoldedHistory {
+        uint64_t length;
+        uint64_t width;
+        uint64_t outPosition; // length % width, where the bit leaving the history is folded in
+        uint64_t mask;
+        uint64_t value;
+    };
+    std::vector<FoldedHistory> folded;
 
 public:
 
@@ -43,6 +59,9 @@ TAGE_GHR(uint64_t length);
  *
  * You need to call this in your code! Note that updating the GHR is the _last_
  * step in updating TAGE; see the end of the "Updating TAGE" section of the PDF.
+ *
+ * This takes constant time per folded history registered with
+ * addFoldedHistory(), whatever the length of the GHR.
  */
 void shiftLeft(bool taken);
 
@@ -61,10 +80,28 @@ uint64_t getHistory();
  * by padding with zeros. However, it is required that width <= 64 and
  * length <= this->length (passed to constructor).
  *
- * Where is this useful? Indexing into TAGE tables (see the PDF).
+ * This walks the history bit by bit. For a (length, width) pair needed on
+ * every branch, register it once with addFoldedHistory() instead.
  */
 uint64_t getCompressedHistory(uint64_t length, uint64_t width);
 
+/**
+ * Registers a compressed history of the last `length' bits in `width' bits,
+ * equal at all times to getCompressedHistory(length, width) but maintained
+ * incrementally as a circular shift register: each shiftLeft() rotates it by
+ * one, XORs in the new bit and XORs out the bit leaving the history. Returns
+ * the handle to pass to getFoldedHistory(). Register before the first
+ * shiftLeft().
+ *
+ * Where is this useful? Indexing into TAGE tables (see the PDF).
+ */
+size_t addFoldedHistory(uint64_t length, uint64_t width);
+
+/**
+ * Returns the compressed history registered as `handle'.
+ */
+uint64_t getFoldedHistory(size_t handle) const { return folded[handle].value; }
+
 };
 
 
@@ -0,0 +1,507 @@
+#include <cinttypes>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "branch_trace.hpp"
+
+static const size_t COMPRESSED_HEADER_SIZE = 4 + 4 + 8 + 8 + 8 + 8 + 8;
+static const size_t BLOCK_INDEX_ENTRY_SIZE = 8 + 8 + 8;
+
+static void put_u32(std::vector<uint8_t>& buf, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        buf.push_back((uint8_t) (value >> (8 * i)));
+    }
+}
+
+static void put_u64(std::vector<uint8_t>& buf, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        buf.push_back((uint8_t) (value >> (8 * i)));
+    }
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static void put_magic(std::vector<uint8_t>& buf, const char *magic) {
+    for (size_t i = 0; i < 4; i++) {
+        buf.push_back((uint8_t) magic[i]);
+    }
+}
+
+static void put_varint(std::vector<uint8_t>& buf, uint64_t value) {
+    while (value >= 0x80) {
+        buf.push_back((uint8_t) (value | 0x80));
+        value >>= 7;
+    }
+    buf.push_back((uint8_t) value);
+}
+
+/* Reads a varint from [*p, end). Returns false on a truncated or overlong
+ * varint */
+static bool get_varint(const uint8_t **p, const uint8_t *end, uint64_t *value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (*p == end) {
+            return false;
+        }
+        uint8_t byte = *(*p)++;
+        result |= (uint64_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool write_buf(const std::vector<uint8_t>& buf, FILE *out) {
+    return fwrite(buf.data(), 1, buf.size(), out) == buf.size();
+}
+
+/* Parses the next text record exactly as the text trace loop in the driver does, except that a line
+ * it would stop making progress on is an error. last_inst_num is the previous record's instruction
+ * count, which the record's must not go below. Returns 1 for a record, 0 at the end of the trace and
+ * -1 on an error */
+static int read_text_branch(FILE *text, uint64_t num_read, uint64_t last_inst_num, branch *branch) {
+    while (!feof(text)) {
+        int is_taken;
+        int ret = std::fscanf(text, "%" PRIx64 " %d %" PRIu64 "\n", &branch->ip, &is_taken, &branch->inst_num);
+        if (ret == EOF) {
+            break;
+        }
+        if (ret != 3) {
+            printf("Malformed record after branch %" PRIu64 "\n", num_read);
+            return -1;
+        }
+        if (branch->inst_num < last_inst_num || branch->inst_num - last_inst_num > (UINT64_MAX >> 1)) {
+            printf("Instruction count of branch %" PRIu64 " goes backwards\n", num_read + 1);
+            return -1;
+        }
+        branch->is_taken = is_taken;
+        return 1;
+    }
+    return 0;
+}
+
+/* Maps the whole file at path read-only. Returns nonzero on failure */
+static int map_file(const char *path, const uint8_t **data, size_t *size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("Could not open `%s'\n", path);
+        return 1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size == 0) {
+        printf("`%s' is empty\n", path);
+        close(fd);
+        return 1;
+    }
+
+    void *mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        printf("Could not map `%s'\n", path);
+        return 1;
+    }
+
+    *data = (const uint8_t *) mapped;
+    *size = st.st_size;
+    return 0;
+}
+
+static void build_header(std::vector<uint8_t>& buf, uint64_t num_branches) {
+    buf.clear();
+    put_magic(buf, BRANCH_TRACE_MAGIC);
+    put_u32(buf, BRANCH_TRACE_VERSION);
+    put_u64(buf, num_branches);
+}
+
+branch_trace_format branch_trace_detect(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return BRANCH_TRACE_TEXT;
+    }
+    char magic[4];
+    branch_trace_format format = BRANCH_TRACE_TEXT;
+    if (fread(magic, 1, sizeof magic, file) == sizeof magic) {
+        if (!memcmp(magic, BRANCH_TRACE_MAGIC, sizeof magic)) {
+            format = BRANCH_TRACE_BINARY;
+        }
+        else if (!memcmp(magic, COMPRESSED_BRANCH_TRACE_MAGIC, sizeof magic)) {
+            format = BRANCH_TRACE_COMPRESSED;
+        }
+    }
+    fclose(file);
+    return format;
+}
+
+int branch_trace_convert(FILE *text, FILE *out, uint64_t *num_branches) {
+    std::vector<uint8_t> buf;
+    uint64_t total = 0;
+    uint64_t last_inst_num = 0;
+
+    /* Reserve the header, it is rewritten once the branch count is known */
+    build_header(buf, 0);
+    if (!write_buf(buf, out)) {
+        printf("Could not write binary trace\n");
+        return 1;
+    }
+
+    buf.clear();
+    branch branch;
+    int ret;
+    while ((ret = read_text_branch(text, total, last_inst_num, &branch)) == 1) {
+        put_u64(buf, branch.ip);
+        put_u64(buf, ((branch.inst_num - last_inst_num) << 1) | branch.is_taken);
+        last_inst_num = branch.inst_num;
+        total++;
+
+        if (buf.size() >= (1 << 16)) {
+            if (!write_buf(buf, out)) {
+                printf("Could not write binary trace\n");
+                return 1;
+            }
+            buf.clear();
+        }
+    }
+    if (ret < 0) {
+        return 1;
+    }
+    if (!write_buf(buf, out)) {
+        printf("Could not write binary trace\n");
+        return 1;
+    }
+
+    build_header(buf, total);
+    if (fseek(out, 0, SEEK_SET) || !write_buf(buf, out) || fflush(out)) {
+        printf("Could not write binary trace header (is the output seekable?)\n");
+        return 1;
+    }
+
+    *num_branches = total;
+    return 0;
+}
+
+int branch_trace_open(const char *path, binary_branch_trace *trace) {
+    if (map_file(path, &trace->data, &trace->size)) {
+        return 1;
+    }
+    if (trace->size < BRANCH_TRACE_HEADER_SIZE) {
+        printf("Binary trace `%s' is truncated\n", path);
+        branch_trace_close(trace);
+        return 1;
+    }
+    trace->records = trace->data + BRANCH_TRACE_HEADER_SIZE;
+    trace->num_branches = branch_trace_get_u64(trace->data + 8);
+
+    if (memcmp(trace->data, BRANCH_TRACE_MAGIC, sizeof BRANCH_TRACE_MAGIC)
+        || get_u32(trace->data + 4) != BRANCH_TRACE_VERSION) {
+        printf("`%s' is not a version %" PRIu32 " binary branch trace\n", path, BRANCH_TRACE_VERSION);
+        branch_trace_close(trace);
+        return 1;
+    }
+
+    if (trace->num_branches != (trace->size - BRANCH_TRACE_HEADER_SIZE) / BRANCH_TRACE_RECORD_SIZE
+        || (trace->size - BRANCH_TRACE_HEADER_SIZE) % BRANCH_TRACE_RECORD_SIZE) {
+        printf("Binary trace `%s' is truncated\n", path);
+        branch_trace_close(trace);
+        return 1;
+    }
+
+    /* Records are read once, front to back */
+    madvise((void *) trace->data, trace->size, MADV_SEQUENTIAL);
+    return 0;
+}
+
+void branch_trace_close(binary_branch_trace *trace) {
+    if (trace->data) {
+        munmap((void *) trace->data, trace->size);
+    }
+    trace->data = NULL;
+    trace->size = 0;
+    trace->records = NULL;
+    trace->num_branches = 0;
+}
+
+int branch_trace_load(const char *path, std::vector<branch>& out) {
+    out.clear();
+    switch (branch_trace_detect(path)) {
+    case BRANCH_TRACE_BINARY: {
+        binary_branch_trace trace = {};
+        if (branch_trace_open(path, &trace)) {
+            return 1;
+        }
+        out.resize(trace.num_branches);
+        branch_trace_cursor cursor;
+        branch_trace_begin(&trace, &cursor);
+        for (uint64_t i = 0; branch_trace_next(&cursor, &out[i]); i++) {
+        }
+        branch_trace_close(&trace);
+        return 0;
+    }
+
+    case BRANCH_TRACE_COMPRESSED: {
+        compressed_branch_trace trace = {};
+        if (branch_trace_open_compressed(path, &trace)) {
+            return 1;
+        }
+        out.reserve(trace.num_branches);
+        std::vector<branch> block;
+        for (uint64_t i = 0; i < trace.blocks.size(); i++) {
+            if (!branch_trace_decode_block(&trace, i, block)) {
+                printf("Block %" PRIu64 " of `%s' is corrupt\n", i, path);
+                branch_trace_close_compressed(&trace);
+                return 1;
+            }
+            out.insert(out.end(), block.begin(), block.end());
+        }
+        branch_trace_close_compressed(&trace);
+        return 0;
+    }
+
+    case BRANCH_TRACE_TEXT:
+    default: {
+        FILE *text = fopen(path, "r");
+        if (!text) {
+            printf("Could not open `%s'\n", path);
+            return 1;
+        }
+        branch branch;
+        uint64_t last_inst_num = 0;
+        int ret;
+        while ((ret = read_text_branch(text, out.size(), last_inst_num, &branch)) == 1) {
+            out.push_back(branch);
+            last_inst_num = branch.inst_num;
+        }
+        fclose(text);
+        return ret < 0;
+    }
+    }
+}
+
+static void build_compressed_header(std::vector<uint8_t>& buf, uint64_t block_size, uint64_t num_branches,
+                                    uint64_t num_ips, uint64_t num_blocks, uint64_t index_offset) {
+    buf.clear();
+    put_magic(buf, COMPRESSED_BRANCH_TRACE_MAGIC);
+    put_u32(buf, COMPRESSED_BRANCH_TRACE_VERSION);
+    put_u64(buf, block_size);
+    put_u64(buf, num_branches);
+    put_u64(buf, num_ips);
+    put_u64(buf, num_blocks);
+    put_u64(buf, index_offset);
+}
+
+static void encode_block(const branch *branches, uint64_t count, uint64_t base_inst_num,
+                         const std::unordered_map<uint64_t, uint64_t>& dictionary, std::vector<uint8_t>& buf) {
+    buf.clear();
+    put_varint(buf, count);
+    put_varint(buf, base_inst_num);
+    for (uint64_t i = 0; i < count; i++) {
+        put_varint(buf, dictionary.at(branches[i].ip));
+    }
+    for (uint64_t i = 0; i < count; i += 8) {
+        uint8_t bits = 0;
+        for (uint64_t j = i; j < count && j < i + 8; j++) {
+            bits |= (uint8_t) branches[j].is_taken << (j - i);
+        }
+        buf.push_back(bits);
+    }
+    uint64_t last_inst_num = base_inst_num;
+    for (uint64_t i = 0; i < count; i++) {
+        put_varint(buf, branches[i].inst_num - last_inst_num);
+        last_inst_num = branches[i].inst_num;
+    }
+}
+
+int branch_trace_compress(const std::vector<branch>& branches, FILE *out, uint64_t block_size) {
+    /* Number the IPs from the most to the least frequent, so the hot branches get one-byte indices.
+     * Ties go to the IP seen first, which keeps the output deterministic */
+    std::unordered_map<uint64_t, uint64_t> counts;
+    std::vector<uint64_t> ips;
+    for (const branch& b : branches) {
+        if (!counts[b.ip]++) {
+            ips.push_back(b.ip);
+        }
+    }
+    std::stable_sort(ips.begin(), ips.end(), [&counts](uint64_t a, uint64_t b) {
+        return counts[a] > counts[b];
+    });
+    std::unordered_map<uint64_t, uint64_t> dictionary;
+    for (uint64_t i = 0; i < ips.size(); i++) {
+        dictionary[ips[i]] = i;
+    }
+
+    std::vector<uint8_t> buf;
+    build_compressed_header(buf, block_size, 0, 0, 0, 0);
+    for (uint64_t ip : ips) {
+        put_u64(buf, ip);
+    }
+    if (!write_buf(buf, out)) {
+        printf("Could not write compressed trace\n");
+        return 1;
+    }
+
+    std::vector<branch_trace_block> blocks;
+    uint64_t offset = buf.size();
+    uint64_t last_inst_num = 0;
+    for (uint64_t first = 0; first < branches.size(); first += block_size) {
+        uint64_t count = std::min<uint64_t>(block_size, branches.size() - first);
+        for (uint64_t i = first; i < first + count; i++) {
+            if (branches[i].inst_num < (i ? branches[i - 1].inst_num : 0)) {
+                printf("Instruction count of branch %" PRIu64 " goes backwards\n", i + 1);
+                return 1;
+            }
+        }
+        encode_block(&branches[first], count, last_inst_num, dictionary, buf);
+        if (!write_buf(buf, out)) {
+            printf("Could not write compressed trace\n");
+            return 1;
+        }
+        branch_trace_block block = {offset, buf.size(), count};
+        blocks.push_back(block);
+        offset += buf.size();
+        last_inst_num = branches[first + count - 1].inst_num;
+    }
+
+    buf.clear();
+    for (const branch_trace_block& block : blocks) {
+        put_u64(buf, block.offset);
+        put_u64(buf, block.length);
+        put_u64(buf, block.count);
+    }
+    if (!write_buf(buf, out)) {
+        printf("Could not write compressed trace\n");
+        return 1;
+    }
+
+    build_compressed_header(buf, block_size, branches.size(), ips.size(), blocks.size(), offset);
+    if (fseek(out, 0, SEEK_SET) || !write_buf(buf, out) || fflush(out)) {
+        printf("Could not write compressed trace header (is the output seekable?)\n");
+        return 1;
+    }
+    return 0;
+}
+
+int branch_trace_open_compressed(const char *path, compressed_branch_trace *trace) {
+    if (map_file(path, &trace->data, &trace->size)) {
+        return 1;
+    }
+
+    if (trace->size < COMPRESSED_HEADER_SIZE) {
+        printf("Compressed trace `%s' is truncated\n", path);
+        branch_trace_close_compressed(trace);
+        return 1;
+    }
+
+    const uint8_t *p = trace->data;
+    trace->block_size = branch_trace_get_u64(p + 8);
+    trace->num_branches = branch_trace_get_u64(p + 16);
+    uint64_t num_ips = branch_trace_get_u64(p + 24);
+    uint64_t num_blocks = branch_trace_get_u64(p + 32);
+    uint64_t index_offset = branch_trace_get_u64(p + 40);
+    trace->ips.clear();
+    trace->blocks.clear();
+
+    if (memcmp(p, COMPRESSED_BRANCH_TRACE_MAGIC, sizeof COMPRESSED_BRANCH_TRACE_MAGIC)
+        || get_u32(p + 4) != COMPRESSED_BRANCH_TRACE_VERSION) {
+        printf("`%s' is not a version %" PRIu32 " compressed branch trace\n", path, COMPRESSED_BRANCH_TRACE_VERSION);
+        branch_trace_close_compressed(trace);
+        return 1;
+    }
+
+    uint64_t blocks_offset = COMPRESSED_HEADER_SIZE + num_ips * 8;
+    if (num_ips > (trace->size - COMPRESSED_HEADER_SIZE) / 8 || index_offset < blocks_offset
+        || index_offset > trace->size || num_blocks > (trace->size - index_offset) / BLOCK_INDEX_ENTRY_SIZE) {
+        printf("Compressed trace `%s' has a corrupt index\n", path);
+        branch_trace_close_compressed(trace);
+        return 1;
+    }
+
+    for (uint64_t i = 0; i < num_ips; i++) {
+        trace->ips.push_back(branch_trace_get_u64(p + COMPRESSED_HEADER_SIZE + i * 8));
+    }
+
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < num_blocks; i++) {
+        const uint8_t *entry = p + index_offset + i * BLOCK_INDEX_ENTRY_SIZE;
+        branch_trace_block block = {branch_trace_get_u64(entry), branch_trace_get_u64(entry + 8),
+                                    branch_trace_get_u64(entry + 16)};
+        if (block.offset < blocks_offset || block.offset > index_offset
+            || block.length > index_offset - block.offset || block.count > trace->block_size) {
+            printf("Compressed trace `%s' has a corrupt index\n", path);
+            branch_trace_close_compressed(trace);
+            return 1;
+        }
+        trace->blocks.push_back(block);
+        total += block.count;
+    }
+
+    if (total != trace->num_branches) {
+        printf("Compressed trace `%s' has a corrupt index\n", path);
+        branch_trace_close_compressed(trace);
+        return 1;
+    }
+
+    return 0;
+}
+
+void branch_trace_close_compressed(compressed_branch_trace *trace) {
+    if (trace->data) {
+        munmap((void *) trace->data, trace->size);
+    }
+    trace->data = NULL;
+    trace->size = 0;
+    trace->ips.clear();
+    trace->blocks.clear();
+}
+
+bool branch_trace_decode_block(const compressed_branch_trace *trace, uint64_t block, std::vector<branch>& out) {
+    const branch_trace_block *info = &trace->blocks[block];
+    const uint8_t *p = trace->data + info->offset;
+    const uint8_t *end = p + info->length;
+    uint64_t count, inst_num;
+    if (!get_varint(&p, end, &count) || count != info->count || !get_varint(&p, end, &inst_num)) {
+        return false;
+    }
+
+    out.resize(count);
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t ip;
+        if (!get_varint(&p, end, &ip) || ip >= trace->ips.size()) {
+            return false;
+        }
+        out[i].ip = trace->ips[ip];
+    }
+
+    uint64_t taken_bytes = (count + 7) / 8;
+    if ((uint64_t) (end - p) < taken_bytes) {
+        return false;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        out[i].is_taken = (p[i / 8] >> (i % 8)) & 1;
+    }
+    p += taken_bytes;
+
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t delta;
+        if (!get_varint(&p, end, &delta)) {
+            return false;
+        }
+        inst_num += delta;
+        out[i].inst_num = inst_num;
+    }
+
+    return p == end;
+}
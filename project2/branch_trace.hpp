@@ -0,0 +1,143 @@
+#ifndef BRANCH_TRACE_H
+#define BRANCH_TRACE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstddef>
+#include <vector>
+#include "branchsim.hpp"
+
+// Binary branch traces hold the records of a text branch trace (one
+// "<ip in hex> <taken> <instruction count>" line per branch) as fixed-size
+// records, so the driver can map the file and walk the records without
+// parsing anything. Each record holds the instruction count as its
+// difference from the previous record's (the first is relative to 0), which
+// leaves room for the taken bit. All integers are little endian.
+//
+// Layout:
+//   header:  "BTRB", u32 version, u64 branches
+//   records: u64 ip, u64 (instruction count delta << 1) | taken
+//
+// Compressed branch traces exploit how few distinct branches a trace holds:
+// the IPs go into a dictionary, ordered from the most to the least frequent
+// branch, and each record keeps its varint dictionary index. Outcomes are
+// packed eight to a byte (branch i of a block is bit i % 8 of byte i / 8)
+// and instruction counts are varint deltas. Records are encoded in blocks
+// that each start from their own absolute instruction count, followed by an
+// index of the blocks, so any block decodes on its own.
+//
+// Layout:
+//   header:     "BTRZ", u32 version, u64 block size, u64 branches,
+//               u64 dictionary entries, u64 blocks, u64 index offset
+//   dictionary: u64 ip per entry
+//   blocks:     varint count, varint instruction count before the block,
+//               varint dictionary indices, packed taken bits, varint
+//               instruction count deltas
+//   index:      per block u64 offset, u64 length in bytes, u64 count
+
+enum branch_trace_format {
+    BRANCH_TRACE_TEXT,
+    BRANCH_TRACE_BINARY,
+    BRANCH_TRACE_COMPRESSED,
+};
+
+// A binary branch trace mapped into memory
+typedef struct binary_branch_trace_t {
+    const uint8_t *data;
+    size_t size;
+    const uint8_t *records;
+    uint64_t num_branches;
+} binary_branch_trace;
+
+// Where one block of a compressed branch trace lives
+typedef struct branch_trace_block_t {
+    uint64_t offset;
+    uint64_t length;
+    uint64_t count;
+} branch_trace_block;
+
+// A compressed branch trace mapped into memory, with its dictionary decoded
+typedef struct compressed_branch_trace_t {
+    const uint8_t *data;
+    size_t size;
+    // Branches per block. Only the last block may hold fewer
+    uint64_t block_size;
+    uint64_t num_branches;
+    std::vector<uint64_t> ips;
+    std::vector<branch_trace_block> blocks;
+} compressed_branch_trace;
+
+// Walks the records of a mapped binary branch trace in order
+typedef struct branch_trace_cursor_t {
+    const uint8_t *next;
+    const uint8_t *end;
+    uint64_t inst_num;
+} branch_trace_cursor;
+
+static const char BRANCH_TRACE_MAGIC[4] = {'B', 'T', 'R', 'B'};
+static const uint32_t BRANCH_TRACE_VERSION = 1;
+static const size_t BRANCH_TRACE_HEADER_SIZE = 4 + 4 + 8;
+static const size_t BRANCH_TRACE_RECORD_SIZE = 8 + 8;
+static const char COMPRESSED_BRANCH_TRACE_MAGIC[4] = {'B', 'T', 'R', 'Z'};
+static const uint32_t COMPRESSED_BRANCH_TRACE_VERSION = 1;
+static const uint64_t DEFAULT_BRANCH_TRACE_BLOCK_SIZE = 1 << 16;
+
+// Tells the format of the file at path from its magic. Anything without one
+// is taken to be a text trace
+branch_trace_format branch_trace_detect(const char *path);
+
+// Converts the text branch trace read from text into a binary branch trace
+// written to out, which must be seekable. Returns nonzero on failure
+int branch_trace_convert(FILE *text, FILE *out, uint64_t *num_branches);
+
+// Maps and validates a binary branch trace. Returns nonzero on failure
+int branch_trace_open(const char *path, binary_branch_trace *trace);
+void branch_trace_close(binary_branch_trace *trace);
+
+// Reads the whole trace at path, in any format, into out (replacing its
+// contents). Returns nonzero on failure
+int branch_trace_load(const char *path, std::vector<branch>& out);
+
+// Encodes branches as a compressed branch trace written to out, in blocks of
+// block_size branches. Instruction counts must not go backwards. Returns
+// nonzero on failure
+int branch_trace_compress(const std::vector<branch>& branches, FILE *out, uint64_t block_size);
+
+// Maps a compressed branch trace and validates its index. Returns nonzero on
+// failure
+int branch_trace_open_compressed(const char *path, compressed_branch_trace *trace);
+void branch_trace_close_compressed(compressed_branch_trace *trace);
+
+// Decodes one block into out (replacing its contents). Safe to call from
+// several threads at once. Returns false if the block is corrupt
+bool branch_trace_decode_block(const compressed_branch_trace *trace, uint64_t block, std::vector<branch>& out);
+
+static inline uint64_t branch_trace_get_u64(const uint8_t *p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static inline void branch_trace_begin(const binary_branch_trace *trace, branch_trace_cursor *cursor) {
+    cursor->next = trace->records;
+    cursor->end = trace->records + trace->num_branches * BRANCH_TRACE_RECORD_SIZE;
+    cursor->inst_num = 0;
+}
+
+// Decodes the next record into branch. Returns false at the end of the trace
+static inline bool branch_trace_next(branch_trace_cursor *cursor, branch *branch) {
+    if (cursor->next == cursor->end) {
+        return false;
+    }
+    uint64_t delta_taken = branch_trace_get_u64(cursor->next + 8);
+    cursor->inst_num += delta_taken >> 1;
+    branch->ip = branch_trace_get_u64(cursor->next);
+    branch->inst_num = cursor->inst_num;
+    branch->is_taken = delta_taken & 1;
+    cursor->next += BRANCH_TRACE_RECORD_SIZE;
+    return true;
+}
+
+#endif
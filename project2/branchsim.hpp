@@ -40,6 +40,21 @@ static const std::map<branchsim_conf_t::PREDICTOR, const char *> pred_to_string
     {branchsim_conf::TAGE, "TAGE-S"},
 };
 
+// Most tagged tables a TAGE predictor can have (the driver caps P at 10)
+const int MAX_TAGGED_TABLES = 10;
+
+// Lookup state a predictor computes in predict() and consumes in update_predictor() for the same
+// branch, so the update does not redo the hashing
+typedef struct branch_lookup_t {
+    uint64_t index;                             // Index into the untagged table (GShare counters, TAGE T0)
+
+    uint64_t partial;                           // TAGE: partial tag of the branch
+    uint64_t tagged_index[MAX_TAGGED_TABLES];   // TAGE: index into each tagged table T(i+1), filled for
+                                                // every table at or above the longest match
+    int longest_match;                          // TAGE: longest table with a matching partial tag,
+                                                // including new entries (0 if none)
+} branch_lookup;
+
 // Structure to hold statistics for a branchsim simulation run
 typedef struct branchsim_stats_t {
     uint64_t total_instructions;            // Use the inst num field of the final branch
@@ -69,17 +84,21 @@ public:
     // Initialize the predictor state including any data structures you might need
     virtual void init_predictor(branchsim_conf *sim_conf) = 0;
 
-    // Return the prediction ({taken/not-taken}, target-address)
-    virtual bool predict(branch *branch, branchsim_stats *sim_stats) = 0;
+    // Return the prediction ({taken/not-taken}, target-address), recording the lookup in lookup
+    virtual bool predict(branch *branch, branch_lookup *lookup, branchsim_stats *sim_stats) = 0;
 
-    // Update the branch predictor state
-    virtual void update_predictor(branch *branch) = 0;
+    // Update the branch predictor state, given the lookup predict() recorded for this branch
+    virtual void update_predictor(branch *branch, const branch_lookup *lookup) = 0;
 
     // Cleanup any allocated memory here
     virtual ~branch_predictor_base() = 0;
 };
 
 
+// Allocate the predictor sim_conf selects (call init_predictor before using it). Predictors hold no
+// shared state, so several can run at once on different threads
+branch_predictor_base *branchsim_new_predictor(const branchsim_conf *sim_conf);
+
 // Function to update branch prediction statistics after the prediction
 void branchsim_update_stats(bool prediction, branch *branch, branchsim_stats *sim_stats);
 
@@ -14,17 +14,21 @@
 
 #include <cstdarg>
 #include <cinttypes>
+#include <cmath>
 #include <cstdio>
 #include <cstdbool>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "branchsim.hpp"
 #include "gshare.hpp"
 #include "tage.hpp"
+#include "branch_trace.hpp"
+#include "sweep.hpp"
 
 // Print message and exit from the application
 static inline void print_error_exit(const char *msg, ...)
@@ -47,6 +51,13 @@ static void print_err_usage(const char *err)
     fprintf(stderr, "-S [Size of Predictor in bits  = 2^S]\n");
     fprintf(stderr, "-P [Associated parameter for predictor]\n");
     fprintf(stderr, "-N [Num stages in modelled pipeline\n");
+    fprintf(stderr, "-I <Trace file, text, binary or compressed>\n");
+    fprintf(stderr, "-Z <Convert the text trace to a binary trace in this file and exit>\n");
+    fprintf(stderr, "-C <Compress the text or binary trace into this file and exit>\n");
+    fprintf(stderr, "-W <Sweep: csv or json> Simulate every combination of the -O, -S, -P and -N lists (e.g. -S 13-19 or -P 0,2)\n");
+    fprintf(stderr, "   on every -I trace (give -I once per trace), skipping invalid P, and print one table\n");
+    fprintf(stderr, "   of MPKI, accuracy and CPI per trace with their geomeans\n");
+    fprintf(stderr, "-J <Worker threads for a sweep, default one per CPU>\n");
     fprintf(stderr, "-H <Print this message>\n");
 
     exit(EXIT_FAILURE);
@@ -82,11 +93,273 @@ static void print_sim_output(branchsim_stats *sim_stats)
 }
 
 
+// Convert the text trace into a binary trace at out_path
+static int convert_trace(FILE *text, const char *out_path)
+{
+    FILE *out = std::fopen(out_path, "wb");
+    if (out == NULL) {
+        printf("Could not open `%s' for writing\n", out_path);
+        return 1;
+    }
+
+    uint64_t num_branches;
+    int ret = branch_trace_convert(text, out, &num_branches);
+    if (!ret && !fseek(out, 0, SEEK_END)) {
+        printf("Converted %" PRIu64 " branches into %s (%ld bytes)\n", num_branches, out_path, ftell(out));
+    }
+    fclose(out);
+    return ret;
+}
+
+// Compress the trace at path into a compressed trace at out_path
+static int compress_trace(const char *path, const char *out_path)
+{
+    std::vector<branch> branches;
+    if (branch_trace_load(path, branches)) {
+        return 1;
+    }
+
+    FILE *out = std::fopen(out_path, "wb");
+    if (out == NULL) {
+        printf("Could not open `%s' for writing\n", out_path);
+        return 1;
+    }
+
+    int ret = branch_trace_compress(branches, out, DEFAULT_BRANCH_TRACE_BLOCK_SIZE);
+    if (!ret && !fseek(out, 0, SEEK_END)) {
+        printf("Compressed %zu branches into %s (%ld bytes)\n", branches.size(), out_path, ftell(out));
+    }
+    fclose(out);
+    return ret;
+}
+
+// Parse a list of values such as "13-19" or "0,2,5-7" into values. Returns false if it is malformed
+static bool parse_list(const char *list, std::vector<uint64_t>& values)
+{
+    values.clear();
+    const char *p = list;
+    while (true) {
+        char *end;
+        uint64_t first = std::strtoull(p, &end, 10);
+        if (end == p) {
+            return false;
+        }
+        uint64_t last = first;
+        p = end;
+        if (*p == '-') {
+            last = std::strtoull(++p, &end, 10);
+            if (end == p || last < first) {
+                return false;
+            }
+            p = end;
+        }
+        for (uint64_t value = first; value <= last; value++) {
+            values.push_back(value);
+        }
+        if (*p == '\0') {
+            return true;
+        }
+        if (*p++ != ',') {
+            return false;
+        }
+    }
+}
+
+// The name of a trace in sweep tables: its file name without the directory or trace extension
+static std::string trace_name(const char *path)
+{
+    std::string name(path);
+    size_t slash = name.rfind('/');
+    if (slash != std::string::npos) {
+        name = name.substr(slash + 1);
+    }
+    for (const char *ext : {".br.trace", ".btrz", ".btr"}) {
+        size_t len = strlen(ext);
+        if (name.size() > len && name.compare(name.size() - len, len, ext) == 0) {
+            name.resize(name.size() - len);
+            break;
+        }
+    }
+    return name;
+}
+
+// Misses per kilo instruction, unrounded
+static double sweep_mpki(const branchsim_stats *sim_stats)
+{
+    return (double) sim_stats->num_branches_mispredicted / sim_stats->total_instructions * 1000;
+}
+
+static double sweep_accuracy(const branchsim_stats *sim_stats)
+{
+    return sim_stats->prediction_accuracy;
+}
+
+static double sweep_cpi(const branchsim_stats *sim_stats)
+{
+    return sim_stats->average_CPI;
+}
+
+// A statistic the sweep reports on every trace, with its geometric mean over the traces
+typedef struct sweep_metric {
+    const char *name;
+    int precision;
+    double (*value)(const branchsim_stats *sim_stats);
+} sweep_metric;
+
+static const sweep_metric SWEEP_METRICS[] = {
+    {"mpki", 4, sweep_mpki},
+    {"accuracy", 6, sweep_accuracy},
+    {"cpi", 6, sweep_cpi},
+};
+static const size_t NUM_SWEEP_METRICS = sizeof(SWEEP_METRICS) / sizeof(SWEEP_METRICS[0]);
+
+// Print the sweep table: a row per configuration, with each metric on each trace and their geometric
+// means
+static void print_sweep(const char *format, const std::vector<std::string>& names,
+                        const std::vector<branchsim_conf>& configs, const std::vector<branchsim_stats>& stats)
+{
+    bool json = !strcmp(format, "json");
+    if (json) {
+        printf("[\n");
+    }
+    else {
+        printf("predictor,S,P,N");
+        for (const sweep_metric& metric : SWEEP_METRICS) {
+            for (const std::string& name : names) {
+                printf(",%s_%s", metric.name, name.c_str());
+            }
+        }
+        for (const sweep_metric& metric : SWEEP_METRICS) {
+            printf(",geomean_%s", metric.name);
+        }
+        printf("\n");
+    }
+
+    for (size_t c = 0; c < configs.size(); c++) {
+        const branchsim_conf *conf = &configs[c];
+        if (json) {
+            printf("  {\"predictor\": \"%s\", \"S\": %" PRIu64 ", \"P\": %" PRIu64 ", \"N\": %" PRIu64,
+                   pred_to_string.at(conf->predictor), conf->S, conf->P, conf->N);
+        }
+        else {
+            printf("%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64, pred_to_string.at(conf->predictor), conf->S, conf->P, conf->N);
+        }
+
+        double geomeans[NUM_SWEEP_METRICS];
+        for (size_t m = 0; m < NUM_SWEEP_METRICS; m++) {
+            const sweep_metric *metric = &SWEEP_METRICS[m];
+            double log_sum = 0;
+            bool zero = false;
+            if (json) {
+                printf(", \"%s\": {", metric->name);
+            }
+            for (size_t t = 0; t < names.size(); t++) {
+                double value = metric->value(&stats[t * configs.size() + c]);
+                zero |= value <= 0;
+                log_sum += value > 0 ? std::log(value) : 0;
+                if (json) {
+                    printf("%s\"%s\": %.*f", t ? ", " : "", names[t].c_str(), metric->precision, value);
+                }
+                else {
+                    printf(",%.*f", metric->precision, value);
+                }
+            }
+            if (json) {
+                printf("}");
+            }
+            geomeans[m] = zero ? 0 : std::exp(log_sum / names.size());
+        }
+
+        for (size_t m = 0; m < NUM_SWEEP_METRICS; m++) {
+            if (json) {
+                printf(", \"geomean_%s\": %.*f", SWEEP_METRICS[m].name, SWEEP_METRICS[m].precision, geomeans[m]);
+            }
+            else {
+                printf(",%.*f", SWEEP_METRICS[m].precision, geomeans[m]);
+            }
+        }
+        if (json) {
+            printf("}%s", c + 1 < configs.size() ? "," : "");
+        }
+        printf("\n");
+    }
+
+    if (json) {
+        printf("]\n");
+    }
+}
+
+// Simulate every valid combination of the lists on every trace, in one process
+static int run_sweep(const char *format, int jobs, const std::vector<const char *>& trace_paths,
+                     const std::vector<uint64_t>& predictors, const std::vector<uint64_t>& sizes,
+                     const std::vector<uint64_t>& params, const std::vector<uint64_t>& stages)
+{
+    std::vector<branchsim_conf> configs;
+    for (uint64_t predictor : predictors) {
+        for (uint64_t S : sizes) {
+            for (uint64_t P : params) {
+                if (predictor == branchsim_conf::GSHARE ? P > 2 : (P < 3 || P > 10)) {
+                    continue;
+                }
+                for (uint64_t N : stages) {
+                    branchsim_conf conf;
+                    conf.predictor = (branchsim_conf::PREDICTOR) predictor;
+                    conf.S = S;
+                    conf.P = P;
+                    conf.N = N;
+                    configs.push_back(conf);
+                }
+            }
+        }
+    }
+    if (configs.empty()) {
+        printf("No valid predictor configuration to sweep\n");
+        return 1;
+    }
+
+    // Each trace is decoded once and shared by every configuration
+    std::vector<std::vector<branch>> traces(trace_paths.size());
+    std::vector<std::string> names;
+    for (size_t t = 0; t < trace_paths.size(); t++) {
+        if (branch_trace_load(trace_paths[t], traces[t])) {
+            return 1;
+        }
+        if (traces[t].empty()) {
+            printf("`%s' holds no branches\n", trace_paths[t]);
+            return 1;
+        }
+        names.push_back(trace_name(trace_paths[t]));
+    }
+
+    std::vector<branchsim_stats> stats;
+    sweep_run(traces, configs, jobs, stats);
+    print_sweep(format, names, configs, stats);
+    return 0;
+}
+
+// Predict one branch, record the outcome and train the predictor
+static inline void simulate_branch(branch_predictor_base *predictor, branch *branch, branch_lookup *lookup,
+                                   branchsim_stats *sim_stats)
+{
+    bool prediction = predictor->predict(branch, lookup, sim_stats);
+    branchsim_update_stats(prediction, branch, sim_stats);
+    predictor->update_predictor(branch, lookup);
+}
+
 // Main function for the simulator driver
 int main(int argc, char *const argv[])
 {
     // Trace file
     FILE *trace = NULL;
+    const char *trace_path = NULL;
+    const char *convert_path = NULL;
+    const char *compress_path = NULL;
+    const char *sweep_format = NULL;
+    int jobs = std::thread::hardware_concurrency();
+    std::vector<const char *> trace_paths;
+    std::vector<uint64_t> predictors, sizes, params, stages;
+    binary_branch_trace binary_trace = {};
+    compressed_branch_trace compressed_trace = {};
 
     // FILE *temp = fopen("temp.trace", "w+");
 
@@ -97,36 +370,62 @@ int main(int argc, char *const argv[])
 
     int opt;
     int pred_num = -1;
-    while (-1 != (opt = getopt(argc, argv, "o:O:s:S:n:N:p:P:i:I:hH"))) {
+    while (-1 != (opt = getopt(argc, argv, "o:O:s:S:n:N:p:P:i:I:z:Z:c:C:w:W:j:J:hH"))) {
         switch (opt) {
             case 'o':
             case 'O':
-                pred_num = std::atoi(optarg);
-                if (pred_num < 1 || pred_num > 2) { print_err_usage("Invalid predictor option"); }
+                if (!parse_list(optarg, predictors)) { print_err_usage("Invalid predictor option"); }
+                for (uint64_t predictor : predictors) {
+                    if (predictor < 1 || predictor > 2) { print_err_usage("Invalid predictor option"); }
+                }
+                pred_num = predictors[0];
                 sim_conf.predictor = (branchsim_conf::PREDICTOR) pred_num;
                 break;
 
             case 's':
             case 'S':
-                sim_conf.S = (uint64_t) std::atoi(optarg);
+                if (!parse_list(optarg, sizes)) { print_err_usage("Invalid predictor size"); }
+                sim_conf.S = sizes[0];
                 break;
 
             case 'p':
             case 'P':
-                sim_conf.P = (uint64_t) std::atoi(optarg);
+                if (!parse_list(optarg, params)) { print_err_usage("Invalid predictor parameter"); }
+                sim_conf.P = params[0];
                 break;
 
             case 'n':
             case 'N':
-                sim_conf.N = (uint64_t) std::atoi(optarg);
+                if (!parse_list(optarg, stages)) { print_err_usage("Invalid number of pipeline stages"); }
+                sim_conf.N = stages[0];
                 break;
 
             case 'i':
             case 'I':
-                trace = std::fopen(optarg, "r");
-                if (trace == NULL) {
-                    print_err_usage("Could not open the input trace file");
-                }
+                trace_path = optarg;
+                trace_paths.push_back(optarg);
+                break;
+
+            case 'z':
+            case 'Z':
+                convert_path = optarg;
+                break;
+
+            case 'c':
+            case 'C':
+                compress_path = optarg;
+                break;
+
+            case 'w':
+            case 'W':
+                if (strcmp(optarg, "csv") && strcmp(optarg, "json")) { print_err_usage("Invalid sweep format"); }
+                sweep_format = optarg;
+                break;
+
+            case 'j':
+            case 'J':
+                jobs = std::atoi(optarg);
+                if (jobs < 1) { print_err_usage("Invalid number of worker threads"); }
                 break;
 
             case 'h':
@@ -139,10 +438,55 @@ int main(int argc, char *const argv[])
         }
     }
 
-    if (!trace) {
+    if (!trace_path) {
         print_err_usage("No trace file provided!");
     }
 
+    if (sweep_format) {
+        if (predictors.empty()) predictors.push_back(sim_conf.predictor);
+        if (sizes.empty()) sizes.push_back(sim_conf.S);
+        if (params.empty()) params.push_back(sim_conf.P);
+        if (stages.empty()) stages.push_back(sim_conf.N);
+        return run_sweep(sweep_format, jobs, trace_paths, predictors, sizes, params, stages);
+    }
+
+    if (predictors.size() > 1 || sizes.size() > 1 || params.size() > 1 || stages.size() > 1 || trace_paths.size() > 1) {
+        print_err_usage("Lists of values and several traces need a sweep (-W)");
+    }
+
+    if (compress_path) {
+        return compress_trace(trace_path, compress_path);
+    }
+
+    // Binary and compressed traces are mapped, text traces are read through fscanf
+    branch_trace_format format = branch_trace_detect(trace_path);
+    if (format != BRANCH_TRACE_TEXT && convert_path) {
+        printf("`%s' is not a text trace\n", trace_path);
+        exit(EXIT_FAILURE);
+    }
+    if (format == BRANCH_TRACE_BINARY) {
+        if (branch_trace_open(trace_path, &binary_trace)) {
+            exit(EXIT_FAILURE);
+        }
+    }
+    else if (format == BRANCH_TRACE_COMPRESSED) {
+        if (branch_trace_open_compressed(trace_path, &compressed_trace)) {
+            exit(EXIT_FAILURE);
+        }
+    }
+    else {
+        trace = std::fopen(trace_path, "r");
+        if (trace == NULL) {
+            print_err_usage("Could not open the input trace file");
+        }
+    }
+
+    if (convert_path) {
+        int ret = convert_trace(trace, convert_path);
+        fclose(trace);
+        return ret;
+    }
+
     print_sim_config(&sim_conf);
 
     if (pred_num == branchsim_conf::PREDICTOR::GSHARE && sim_conf.P > 2) {
@@ -159,25 +503,44 @@ int main(int argc, char *const argv[])
     printf("SETUP COMPLETE - STARTING SIMULATION\n");
 
     // Allocate the predictor
-    branch_predictor_base *predictor;
-    switch (sim_conf.predictor) {
-
-    case branchsim_conf::TAGE:
-        predictor = new tage();
-        break;
-
-    case branchsim_conf::GSHARE:
-    default:
-        predictor = new gshare();
-        break;
-    }
+    branch_predictor_base *predictor = branchsim_new_predictor(&sim_conf);
 
     // Initialize the predictor
     predictor->init_predictor(&sim_conf);
 
     branch branch;
+    branch_lookup lookup;
     size_t num_branches = 0;
-    while (!feof(trace)) {
+    if (binary_trace.data) {
+        branch_trace_cursor cursor;
+        branch_trace_begin(&binary_trace, &cursor);
+        while (branch_trace_next(&cursor, &branch)) {
+            #ifdef DEBUG
+                printf("Branch: %" PRIu64 "\n", (num_branches + 1));
+            #endif
+
+            simulate_branch(predictor, &branch, &lookup, &sim_stats);
+            num_branches++;
+        }
+    }
+    if (compressed_trace.data) {
+        std::vector<struct branch_t> block;
+        for (uint64_t i = 0; i < compressed_trace.blocks.size(); i++) {
+            if (!branch_trace_decode_block(&compressed_trace, i, block)) {
+                printf("Block %" PRIu64 " of the compressed trace is corrupt\n", i);
+                exit(EXIT_FAILURE);
+            }
+            for (struct branch_t& b : block) {
+                #ifdef DEBUG
+                    printf("Branch: %" PRIu64 "\n", (num_branches + 1));
+                #endif
+
+                simulate_branch(predictor, &b, &lookup, &sim_stats);
+                num_branches++;
+            }
+        }
+    }
+    while (trace && !feof(trace)) {
         int is_taken;
         int ret = std::fscanf(trace, "%" PRIx64 " %d %" PRIu64 "\n", &branch.ip, &is_taken, &branch.inst_num);
 
@@ -189,9 +552,7 @@ int main(int argc, char *const argv[])
                 printf("Branch: %" PRIu64 "\n", (num_branches + 1));
             #endif
 
-            bool prediction = predictor->predict(&branch, &sim_stats);
-            branchsim_update_stats(prediction, &branch, &sim_stats);
-            predictor->update_predictor(&branch);
+            simulate_branch(predictor, &branch, &lookup, &sim_stats);
 
             num_branches++;
         }
@@ -204,7 +565,11 @@ int main(int argc, char *const argv[])
     // This calls the destructor of the predictor before freeing the allocated memory
     delete predictor;
 
-    fclose(trace);
+    if (trace) {
+        fclose(trace);
+    }
+    branch_trace_close(&binary_trace);
+    branch_trace_close_compressed(&compressed_trace);
 
     print_sim_output(&sim_stats);
 
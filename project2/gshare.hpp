@@ -2,34 +2,40 @@
 #define GSHARE_H
 
 #include "branchsim.hpp"
+#include <vector>
 #include "Counter.hpp"
 
-/* GSHARE class predictor definition */
+/* GSHARE class predictor definition, specialized on the hash function P selects (0, 1 or 2) so the
+ * choice is made once when the predictor is allocated rather than on every branch */
+template <int HASH>
 class gshare : public branch_predictor_base
 {
     private:
-        int g, p, t_size;
-        uint64_t ghr;
-        Counter ** counters;
-        uint64_t * tags;
+        int g, t_size;
+        uint64_t ghr, mask;
+        CounterTable counters;
+        std::vector<uint64_t> tags;
 
     public:
         /* Shifts in new value to the GHR */
         void shift_ghr(int new_val);
 
         /* Hash functions for indexing into Smith counter table */
-        uint64_t hash_0(uint64_t pc);
-        uint64_t hash_1(uint64_t pc);
-        uint64_t hash_2(uint64_t pc);
+        uint64_t hash_0(uint64_t pc) { return ((pc >> 2) ^ ghr) & mask; }
+        uint64_t hash_1(uint64_t pc) { return (pc ^ ghr) & mask; }
+        uint64_t hash_2(uint64_t pc) { return ((pc >> 2) + ghr) & mask; }
+
+        /* Indexes into Smith counter table with the selected hash function */
+        uint64_t hash(uint64_t pc) { return HASH == 0 ? hash_0(pc) : HASH == 1 ? hash_1(pc) : hash_2(pc); }
         
         /* Initializes GSHARE predictor */
         void init_predictor(branchsim_conf *sim_conf);
 
         /* Returns predicted value for the given instruction */
-        bool predict(branch *branch, branchsim_stats *sim_stats);
+        bool predict(branch *branch, branch_lookup *lookup, branchsim_stats *sim_stats);
 
         /* Updates GSHARE branch predictor state */
-        void update_predictor(branch *branch);
+        void update_predictor(branch *branch, const branch_lookup *lookup);
 
         /* Frees any allocated memory */
         ~gshare();
@@ -1,310 +1,10 @@
 #!/bin/sh
 
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 13 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 13 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 13 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 13 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 14 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 14 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 14 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 14 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 15 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 15 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 15 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 15 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 16 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 16 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 16 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 16 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 17 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 17 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 17 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 17 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 18 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 18 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 18 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 18 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 19 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 19 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 19 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 19 -O 1 -P 0 >> gshare.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 13 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 13 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 13 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 13 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 14 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 14 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 14 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 14 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 15 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 15 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 15 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 15 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 16 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 16 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 16 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 16 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 17 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 17 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 17 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 17 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 18 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 18 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 18 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 18 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 19 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 19 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 19 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 19 -O 1 -P 1 >> gshare.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 13 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 13 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 13 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 13 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 14 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 14 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 14 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 14 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 15 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 15 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 15 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 15 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 16 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 16 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 16 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 16 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 17 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 17 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 17 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 17 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 18 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 18 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 18 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 18 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 19 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 19 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 19 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 19 -O 1 -P 2 >> gshare.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 13 -O 2 -P 3 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 13 -O 2 -P 3 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 13 -O 2 -P 3 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 13 -O 2 -P 3 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 14 -O 2 -P 3 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 14 -O 2 -P 3 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 14 -O 2 -P 3 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 14 -O 2 -P 3 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 15 -O 2 -P 3 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 15 -O 2 -P 3 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 15 -O 2 -P 3 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 15 -O 2 -P 3 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 16 -O 2 -P 3 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 16 -O 2 -P 3 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 16 -O 2 -P 3 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 16 -O 2 -P 3 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 17 -O 2 -P 3 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 17 -O 2 -P 3 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 17 -O 2 -P 3 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 17 -O 2 -P 3 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 18 -O 2 -P 3 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 18 -O 2 -P 3 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 18 -O 2 -P 3 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 18 -O 2 -P 3 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 19 -O 2 -P 3 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 19 -O 2 -P 3 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 19 -O 2 -P 3 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 19 -O 2 -P 3 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 13 -O 2 -P 4 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 13 -O 2 -P 4 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 13 -O 2 -P 4 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 13 -O 2 -P 4 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 14 -O 2 -P 4 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 14 -O 2 -P 4 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 14 -O 2 -P 4 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 14 -O 2 -P 4 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 15 -O 2 -P 4 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 15 -O 2 -P 4 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 15 -O 2 -P 4 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 15 -O 2 -P 4 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 16 -O 2 -P 4 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 16 -O 2 -P 4 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 16 -O 2 -P 4 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 16 -O 2 -P 4 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 17 -O 2 -P 4 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 17 -O 2 -P 4 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 17 -O 2 -P 4 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 17 -O 2 -P 4 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 18 -O 2 -P 4 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 18 -O 2 -P 4 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 18 -O 2 -P 4 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 18 -O 2 -P 4 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 19 -O 2 -P 4 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 19 -O 2 -P 4 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 19 -O 2 -P 4 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 19 -O 2 -P 4 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 13 -O 2 -P 5 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 13 -O 2 -P 5 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 13 -O 2 -P 5 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 13 -O 2 -P 5 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 14 -O 2 -P 5 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 14 -O 2 -P 5 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 14 -O 2 -P 5 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 14 -O 2 -P 5 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 15 -O 2 -P 5 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 15 -O 2 -P 5 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 15 -O 2 -P 5 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 15 -O 2 -P 5 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 16 -O 2 -P 5 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 16 -O 2 -P 5 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 16 -O 2 -P 5 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 16 -O 2 -P 5 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 17 -O 2 -P 5 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 17 -O 2 -P 5 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 17 -O 2 -P 5 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 17 -O 2 -P 5 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 18 -O 2 -P 5 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 18 -O 2 -P 5 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 18 -O 2 -P 5 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 18 -O 2 -P 5 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 19 -O 2 -P 5 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 19 -O 2 -P 5 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 19 -O 2 -P 5 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 19 -O 2 -P 5 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 13 -O 2 -P 6 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 13 -O 2 -P 6 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 13 -O 2 -P 6 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 13 -O 2 -P 6 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 14 -O 2 -P 6 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 14 -O 2 -P 6 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 14 -O 2 -P 6 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 14 -O 2 -P 6 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 15 -O 2 -P 6 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 15 -O 2 -P 6 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 15 -O 2 -P 6 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 15 -O 2 -P 6 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 16 -O 2 -P 6 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 16 -O 2 -P 6 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 16 -O 2 -P 6 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 16 -O 2 -P 6 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 17 -O 2 -P 6 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 17 -O 2 -P 6 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 17 -O 2 -P 6 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 17 -O 2 -P 6 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 18 -O 2 -P 6 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 18 -O 2 -P 6 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 18 -O 2 -P 6 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 18 -O 2 -P 6 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 19 -O 2 -P 6 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 19 -O 2 -P 6 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 19 -O 2 -P 6 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 19 -O 2 -P 6 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 13 -O 2 -P 7 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 13 -O 2 -P 7 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 13 -O 2 -P 7 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 13 -O 2 -P 7 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 14 -O 2 -P 7 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 14 -O 2 -P 7 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 14 -O 2 -P 7 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 14 -O 2 -P 7 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 15 -O 2 -P 7 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 15 -O 2 -P 7 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 15 -O 2 -P 7 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 15 -O 2 -P 7 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 16 -O 2 -P 7 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 16 -O 2 -P 7 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 16 -O 2 -P 7 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 16 -O 2 -P 7 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 17 -O 2 -P 7 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 17 -O 2 -P 7 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 17 -O 2 -P 7 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 17 -O 2 -P 7 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 18 -O 2 -P 7 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 18 -O 2 -P 7 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 18 -O 2 -P 7 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 18 -O 2 -P 7 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 19 -O 2 -P 7 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 19 -O 2 -P 7 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 19 -O 2 -P 7 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 19 -O 2 -P 7 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 13 -O 2 -P 8 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 13 -O 2 -P 8 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 13 -O 2 -P 8 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 13 -O 2 -P 8 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 14 -O 2 -P 8 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 14 -O 2 -P 8 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 14 -O 2 -P 8 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 14 -O 2 -P 8 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 15 -O 2 -P 8 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 15 -O 2 -P 8 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 15 -O 2 -P 8 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 15 -O 2 -P 8 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 16 -O 2 -P 8 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 16 -O 2 -P 8 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 16 -O 2 -P 8 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 16 -O 2 -P 8 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 17 -O 2 -P 8 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 17 -O 2 -P 8 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 17 -O 2 -P 8 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 17 -O 2 -P 8 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 18 -O 2 -P 8 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 18 -O 2 -P 8 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 18 -O 2 -P 8 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 18 -O 2 -P 8 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 19 -O 2 -P 8 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 19 -O 2 -P 8 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 19 -O 2 -P 8 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 19 -O 2 -P 8 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 13 -O 2 -P 9 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 13 -O 2 -P 9 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 13 -O 2 -P 9 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 13 -O 2 -P 9 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 14 -O 2 -P 9 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 14 -O 2 -P 9 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 14 -O 2 -P 9 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 14 -O 2 -P 9 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 15 -O 2 -P 9 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 15 -O 2 -P 9 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 15 -O 2 -P 9 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 15 -O 2 -P 9 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 16 -O 2 -P 9 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 16 -O 2 -P 9 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 16 -O 2 -P 9 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 16 -O 2 -P 9 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 17 -O 2 -P 9 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 17 -O 2 -P 9 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 17 -O 2 -P 9 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 17 -O 2 -P 9 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 18 -O 2 -P 9 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 18 -O 2 -P 9 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 18 -O 2 -P 9 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 18 -O 2 -P 9 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 19 -O 2 -P 9 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 19 -O 2 -P 9 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 19 -O 2 -P 9 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 19 -O 2 -P 9 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 13 -O 2 -P 10 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 13 -O 2 -P 10 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 13 -O 2 -P 10 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 13 -O 2 -P 10 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 14 -O 2 -P 10 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 14 -O 2 -P 10 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 14 -O 2 -P 10 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 14 -O 2 -P 10 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 15 -O 2 -P 10 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 15 -O 2 -P 10 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 15 -O 2 -P 10 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 15 -O 2 -P 10 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 16 -O 2 -P 10 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 16 -O 2 -P 10 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 16 -O 2 -P 10 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 16 -O 2 -P 10 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 17 -O 2 -P 10 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 17 -O 2 -P 10 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 17 -O 2 -P 10 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 17 -O 2 -P 10 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 18 -O 2 -P 10 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 18 -O 2 -P 10 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 18 -O 2 -P 10 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 18 -O 2 -P 10 >> tages.out
-./branchsim -I traces/gcc.10m.br.trace -N 50 -S 19 -O 2 -P 10 >> tages.out
-./branchsim -I traces/mcf.10m.br.trace -N 50 -S 19 -O 2 -P 10 >> tages.out
-./branchsim -I traces/perlbench.10m.br.trace -N 50 -S 19 -O 2 -P 10 >> tages.out
-./branchsim -I traces/x264.10m.br.trace -N 50 -S 19 -O 2 -P 10 >> tages.out
+# Every GShare hash function (P 0-2) and TAGE table count (P 3-10) at sizes S 13-19 with a 50-stage
+# pipeline, on each benchmark trace, simulated in one process. Each trace is read once; the table of
+# per-trace MPKI, accuracy and CPI and their geomeans goes to search.csv
+./branchsim -W csv -O 1,2 -S 13-19 -P 0-10 -N 50 \
+    -I traces/gcc.10m.br.trace \
+    -I traces/mcf.10m.br.trace \
+    -I traces/perlbench.10m.br.trace \
+    -I traces/x264.10m.br.trace > search.csv
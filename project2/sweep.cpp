@@ -0,0 +1,90 @@
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "sweep.hpp"
+
+// Tasks dealt to one worker. Its owner pops from the back, thieves from the front
+typedef struct sweep_queue_t {
+    std::mutex lock;
+    std::deque<size_t> tasks;
+} sweep_queue;
+
+/* Takes the next task for worker self, stealing one if its own queue is empty. No task is queued
+ * once the workers start, so finding every queue empty means the sweep is done */
+static bool next_task(std::vector<sweep_queue>& queues, size_t self, size_t *task) {
+    {
+        std::lock_guard<std::mutex> guard(queues[self].lock);
+        if (!queues[self].tasks.empty()) {
+            *task = queues[self].tasks.back();
+            queues[self].tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues.size(); i++) {
+        sweep_queue& victim = queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tasks.empty()) {
+            *task = victim.tasks.front();
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Simulates one configuration over one whole trace */
+static void simulate_trace(const std::vector<branch>& trace, branchsim_conf sim_conf, branchsim_stats *sim_stats) {
+    memset(sim_stats, 0, sizeof *sim_stats);
+    branch_predictor_base *predictor = branchsim_new_predictor(&sim_conf);
+    predictor->init_predictor(&sim_conf);
+
+    branch_lookup lookup;
+    for (const branch& b : trace) {
+        branch current = b;
+        bool prediction = predictor->predict(&current, &lookup, sim_stats);
+        branchsim_update_stats(prediction, &current, sim_stats);
+        predictor->update_predictor(&current, &lookup);
+    }
+
+    sim_stats->N = sim_conf.N;
+    branchsim_finish_stats(sim_stats);
+    delete predictor;
+}
+
+void sweep_run(const std::vector<std::vector<branch>>& traces, const std::vector<branchsim_conf>& configs,
+               int jobs, std::vector<branchsim_stats>& stats) {
+    size_t num_tasks = traces.size() * configs.size();
+    stats.assign(num_tasks, branchsim_stats());
+    if (jobs < 1) {
+        jobs = 1;
+    }
+    if ((size_t) jobs > num_tasks) {
+        jobs = num_tasks ? num_tasks : 1;
+    }
+
+    /* Deal the tasks round robin, so every worker starts with a mix of traces and configurations */
+    std::vector<sweep_queue> queues(jobs);
+    for (size_t task = 0; task < num_tasks; task++) {
+        queues[task % jobs].tasks.push_back(task);
+    }
+
+    auto work = [&](size_t self) {
+        size_t task;
+        while (next_task(queues, self, &task)) {
+            size_t t = task / configs.size();
+            size_t c = task % configs.size();
+            simulate_trace(traces[t], configs[c], &stats[task]);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < jobs; i++) {
+        workers.emplace_back(work, i);
+    }
+    work(0);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
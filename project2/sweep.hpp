@@ -0,0 +1,22 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <cstddef>
+#include <vector>
+#include "branchsim.hpp"
+
+// Evaluates every predictor configuration on every trace in one process. The
+// traces are decoded once (see branch_trace_load) and shared read-only by
+// the workers; each (trace, configuration) pair is one task, simulated start
+// to finish on one thread with a predictor of its own. Tasks are dealt out
+// to per-worker queues up front. A worker takes tasks from the back of its
+// own queue and, once that is empty, steals from the front of the others',
+// so a worker left with slow TAGE configurations gets help from the rest.
+
+// Simulates every configuration on every trace with jobs worker threads.
+// stats[t * configs.size() + c] receives the finished statistics of
+// configuration c on trace t, whatever order the tasks ran in
+void sweep_run(const std::vector<std::vector<branch>>& traces, const std::vector<branchsim_conf>& configs,
+               int jobs, std::vector<branchsim_stats>& stats);
+
+#endif
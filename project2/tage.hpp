@@ -3,6 +3,7 @@
 
 #include "branchsim.hpp"
 #include "TAGE_GHR.hpp"
+#include <vector>
 #include "Counter.hpp"
 
 /* TAGE-S class predictor definition */
@@ -10,33 +11,39 @@ class tage : public branch_predictor_base {
 
     private:
         int h, t, e, p, t0_size, tx_size;
+        uint64_t h_mask, e_mask, t_mask;
         TAGE_GHR ghr;
-        Counter ** table_zero;
-        Counter *** tagged_predictors;
-        Counter *** tagged_useful;
-        uint64_t ** partial_tags;
+        std::vector<int> history_lengths;
+        CounterTable table_zero;
+        /* tagged tables are stored back to back, entry j of table T(i+1) is at i * tx_size + j */
+        CounterTable tagged_predictors;
+        CounterTable tagged_useful;
+        std::vector<uint16_t> partial_tags;
 
     public:
-        /* Returns the length of the history for a given table */
-        int history_length(int x);
+        /* Returns the length of the history for a given table, computed in init_predictor */
+        int history_length(int x) { return history_lengths[x]; }
 
-        /* Hash function to index into T0 predictor table */
-        uint64_t hash_bimodal(uint64_t pc);
+        /* Hash function to index into T0 predictor table: pc[2 + h - 1:2] */
+        uint64_t hash_bimodal(uint64_t pc) { return (pc >> 2) & h_mask; }
 
-        /* Hash function to index into tagged table */
-        uint64_t hash_tagged(uint64_t pc, int i);
+        /* Hash function to index into tagged table: pc[2 + e - 1:2] XOR the table's folded history */
+        uint64_t hash_tagged(uint64_t pc, int i) { return ((pc >> 2) ^ ghr.getFoldedHistory(i - 1)) & e_mask; }
 
-        /* Returns the partial tag for the given instruction */
-        uint64_t get_partial(uint64_t pc);
+        /* Returns the position of an entry of table T(i+1) in the tagged tables */
+        uint64_t tagged_entry(int i, uint64_t index) { return (uint64_t) i * tx_size + index; }
+
+        /* Returns the partial tag for the given instruction: pc[2 + e + t - 1:2 + e] XOR ghr[t - 1:0] */
+        uint64_t get_partial(uint64_t pc) { return ((pc >> (2 + e)) ^ ghr.getHistory()) & t_mask; }
 
         /* Initializes TAGE-S predictor */
         void init_predictor(branchsim_conf *sim_conf);
         
         /* Returns predicted value for the given instruction */
-        bool predict(branch *branch, branchsim_stats *sim_stats);
+        bool predict(branch *branch, branch_lookup *lookup, branchsim_stats *sim_stats);
         
         /* Updates TAGE-S branch predictor state */
-        void update_predictor(branch *branch);
+        void update_predictor(branch *branch, const branch_lookup *lookup);
 
         /* Frees any allocated memory */
         ~tage();
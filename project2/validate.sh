@@ -36,9 +36,15 @@ ta_stat_path() {
     printf '%s' "ref_outs/${config}_${benchmark}.10m.out"
 }
 
+# Prefers the binary copy of the trace (see `make traces') when there is one newer than the text trace,
+# so a stale copy is never validated in its place
 benchmark_path() {
     benchmark=$1
-    printf '%s' "traces/$benchmark.10m.br.trace"
+    if [[ traces/$benchmark.10m.btr -nt traces/$benchmark.10m.br.trace ]]; then
+        printf '%s' "traces/$benchmark.10m.btr"
+    else
+        printf '%s' "traces/$benchmark.10m.br.trace"
+    fi
 }
 
 human_friendly_config() {